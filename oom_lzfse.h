@@ -0,0 +1,146 @@
+// oomer wrapper code for streaming lzfse decoding
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>     // For std::memset/std::memmove
+#include <algorithm>   // For std::min/std::max
+#include <memory>      // For std::unique_ptr
+#include <functional>  // For std::function
+#include <iostream>
+#include <stdexcept>
+
+#include "oom_misc.h"  // For MappedFile
+#include "oom_lzfse_block.h" // For the LZFSE block headers
+
+// lzfse_decode and its state are internal to liblzfse, which is built as C
+extern "C" {
+#include "../lzfse/src/lzfse_internal.h"
+}
+
+namespace oom {
+    namespace misc {
+        // Bytes kept behind the write position while streaming so LZFSE/LZVN back references
+        // can still reach them, the encoder never emits a match distance above 400000
+        constexpr size_t LZFSE_STREAM_HISTORY = 512 * 1024;
+        // Default number of fresh bytes handed to the callback per call
+        constexpr size_t LZFSE_STREAM_WINDOW = 1024 * 1024;
+
+        // Streaming LZFSE decompressor with bounded memory
+        // Decodes block by block through liblzfse's lzfse_decode into a window and hands the output to
+        // onChunk, the whole decompressed payload is never held at once. Every compressed block is given
+        // to lzfse_decode whole, with room for all of its output: lzfse_decode rebuilds its LZVN state on
+        // each call, so stopping inside a bvxn block (a DST_FULL in the middle of a match) can't be resumed.
+        // Uncompressed bvx- blocks, which the encoder emits for the whole input when compression doesn't
+        // pay, are copied from the mapping in window sized slices instead.
+        // Peak memory is LZFSE_STREAM_HISTORY + max(windowSize, largest compressed block) plus the decoder
+        // state. The encoder only writes bvxn for inputs under 4 KiB and closes a bvx2 block at 10000 matches
+        // or 40000 literals, so a compressed block decodes to at most about 23 MB (40000 literals plus 10000
+        // matches of 2359 bytes) and to a few hundred KiB on real scenes. Input pages are dropped from the
+        // mapping as soon as the decoder is past them.
+        // Note: lzfse_decode is internal to liblzfse, link it from source (as we do) rather than as a shared lib
+        // @param dirName: the name of the directory containing the LZFSE file
+        // @param compressedName: the name of the LZFSE file to decompress
+        // @param onChunk: receives consecutive slices of the output, return false to stop early
+        // @param windowSize: bytes gathered before onChunk is called, a slice ends on a block boundary
+        // @return total number of bytes handed to onChunk
+        inline size_t decompressLZFSE(const std::string& dirName,
+                                      const std::string& compressedName,
+                                      const std::function<bool(const uint8_t* data, size_t size)>& onChunk,
+                                      size_t windowSize = LZFSE_STREAM_WINDOW) {
+                std::string lzfseFullName = dirName + "/"+compressedName;
+
+                // Report on cerr like the rest of the repo, and carry the same text in the exception
+                auto fail = [&](const std::string& cause) {
+                    std::string message = "decompressLZFSE: " + cause + ": " + lzfseFullName;
+                    std::cerr << "Error: " << message << std::endl;
+                    throw std::runtime_error(message);
+                };
+
+                MappedFile lzfseFile;
+                if (!lzfseFile.open(lzfseFullName)) fail("could not open input file");
+
+                // Decoder state is large (tables for every block type), keep it off the stack
+                std::unique_ptr<lzfse_decoder_state> state(new lzfse_decoder_state);
+                std::memset(state.get(), 0, sizeof(lzfse_decoder_state));
+                windowSize = std::max<size_t>(windowSize, 1);
+                std::vector<uint8_t> window(LZFSE_STREAM_HISTORY + windowSize);
+                const uint8_t* src = lzfseFile.data();
+                const size_t srcSize = lzfseFile.size();
+
+                size_t total = 0;
+                size_t used = 0;      // bytes in the window, history then pending output
+                size_t pending = 0;   // first byte not yet handed to onChunk
+                // Hand the pending bytes over, then keep the last LZFSE_STREAM_HISTORY bytes at the front
+                auto flush = [&]() {
+                    size_t fresh = used - pending;
+                    total += fresh;
+                    if (fresh > 0 && !onChunk(window.data() + pending, fresh)) return false;
+                    size_t keep = std::min(LZFSE_STREAM_HISTORY, used);
+                    std::memmove(window.data(), window.data() + used - keep, keep);
+                    used = keep;
+                    pending = keep;
+                    return true;
+                };
+
+                size_t pos = 0;
+                while (true) {
+                    LzfseBlock block;
+                    if (!lzfseReadBlock(src + pos, srcSize - pos, block) || block.blockBytes == 0) {
+                        fail("corrupt or truncated block header at offset " + std::to_string(pos));
+                    }
+                    if (block.magic == LZFSE_ENDOFSTREAM_MAGIC) {
+                        flush();
+                        break;
+                    }
+                    if (block.magic == LZFSE_UNCOMPRESSED_MAGIC) {
+                        // Raw bytes, copy them through the window a slice at a time so the window never grows
+                        if (block.blockBytes != 8 + block.rawBytes) fail("corrupt bvx- block at offset " + std::to_string(pos));
+                        const uint8_t* raw = src + pos + 8;
+                        size_t remaining = block.rawBytes;
+                        bool stopped = false;
+                        while (remaining > 0) {
+                            size_t slice = std::min(remaining, std::min(windowSize - std::min(windowSize, used - pending), window.size() - used));
+                            std::memcpy(window.data() + used, raw, slice);
+                            used += slice;
+                            raw += slice;
+                            remaining -= slice;
+                            lzfseFile.discard(static_cast<size_t>(raw - src));
+                            if ((used - pending >= windowSize || used == window.size()) && !flush()) {
+                                stopped = true;
+                                break;
+                            }
+                        }
+                        if (stopped) break;
+                        pos += block.blockBytes;
+                        continue;
+                    }
+                    if (used + block.rawBytes > window.size()) {
+                        if (!flush()) break;
+                        // A block larger than the window grows it, the decoder needs all of it in one go
+                        if (used + block.rawBytes > window.size()) window.resize(used + block.rawBytes);
+                    }
+
+                    // Pointers are set on every call, the window may have moved or grown
+                    state->src = src + pos;
+                    state->src_begin = src;
+                    state->src_end = src + pos + block.blockBytes;
+                    state->dst_begin = window.data();   // back references may not reach before this
+                    state->dst = window.data() + used;
+                    state->dst_end = state->dst + block.rawBytes;
+                    // The block decodes completely, then the decoder stops for lack of a next header
+                    int status = lzfse_decode(state.get());
+                    if (status != LZFSE_STATUS_SRC_EMPTY || state->src != state->src_end || state->dst != state->dst_end) {
+                        fail("corrupt block at offset " + std::to_string(pos) + ", lzfse_decode status " + std::to_string(status));
+                    }
+                    used += block.rawBytes;
+                    pos += block.blockBytes;
+                    lzfseFile.discard(pos);
+                    if (used - pending >= windowSize && !flush()) break;
+                }
+                return total;
+        }
+    }
+}
@@ -0,0 +1,75 @@
+// oomer wrapper code for reading lzfse block headers
+// Plain C++, no lzfse includes, so anything that only walks headers stays off liblzfse's internal API
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace oom {
+    namespace misc {
+        // LZFSE block magics, little endian "bvx?"
+        constexpr uint32_t LZFSE_ENDOFSTREAM_MAGIC  = 0x24787662; // bvx$
+        constexpr uint32_t LZFSE_UNCOMPRESSED_MAGIC = 0x2d787662; // bvx-
+        constexpr uint32_t LZFSE_COMPRESSEDV1_MAGIC = 0x31787662; // bvx1
+        constexpr uint32_t LZFSE_COMPRESSEDV2_MAGIC = 0x32787662; // bvx2
+        constexpr uint32_t LZFSE_COMPRESSEDLZVN_MAGIC = 0x6e787662; // bvxn
+
+        // One block of an LZFSE stream, from its header alone
+        struct LzfseBlock {
+            uint32_t magic = 0;
+            uint64_t rawBytes = 0;      // bytes the block decodes to
+            uint64_t blockBytes = 0;    // header and payload
+        };
+
+        /**
+        * Read the header of the block at src
+        * @param available bytes from src to the end of the stream
+        * @return false for an unknown, truncated or malformed block. bvx1 is an in-memory only format and
+        *         never appears in files, it is reported as unknown. blockBytes is at least 4 on success
+        */
+        inline bool lzfseReadBlock(const uint8_t* src, size_t available, LzfseBlock& block) {
+            auto read32 = [](const uint8_t* p) {
+                return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+            };
+            auto read64 = [&](const uint8_t* p) {
+                return uint64_t(read32(p)) | (uint64_t(read32(p + 4)) << 32);
+            };
+            if (available < 4) return false;
+            block.magic = read32(src);
+            block.rawBytes = 0;
+            switch (block.magic) {
+                case LZFSE_ENDOFSTREAM_MAGIC:
+                    block.blockBytes = 4;
+                    return true;
+                case LZFSE_UNCOMPRESSED_MAGIC: // magic, n_raw_bytes, raw bytes
+                    if (available < 8) return false;
+                    block.blockBytes = 8 + uint64_t(read32(src + 4));
+                    break;
+                case LZFSE_COMPRESSEDLZVN_MAGIC: // magic, n_raw_bytes, n_payload_bytes, payload
+                    if (available < 12) return false;
+                    block.blockBytes = 12 + uint64_t(read32(src + 8));
+                    break;
+                case LZFSE_COMPRESSEDV2_MAGIC: { // magic, n_raw_bytes, packed_fields[3], freq tables, payload
+                    if (available < 32) return false;
+                    uint64_t v0 = read64(src + 8);
+                    uint64_t v1 = read64(src + 16);
+                    uint64_t v2 = read64(src + 24);
+                    uint64_t headerSize = v2 & 0xffffffff;
+                    uint64_t literalPayloadBytes = (v0 >> 20) & 0xfffff;
+                    uint64_t lmdPayloadBytes = (v1 >> 40) & 0xfffff;
+                    // The header itself is 32 bytes before the frequency tables, a smaller size is corrupt
+                    // and would leave the walk standing still
+                    if (headerSize < 32) return false;
+                    block.blockBytes = headerSize + literalPayloadBytes + lmdPayloadBytes;
+                    if (block.blockBytes < headerSize) return false;
+                    break;
+                }
+                default:
+                    return false;
+            }
+            block.rawBytes = read32(src + 4);
+            return block.blockBytes <= available;
+        }
+    }
+}
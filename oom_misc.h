@@ -5,12 +5,162 @@
 #include <filesystem>  // For std::filesystem
 #include <cmath>      // For std::pow
 #include <vector>
+#include <cstdint>    // For uint8_t
+#include <cstring>    // For std::memcpy
+#include <stdexcept>  // For std::runtime_error
+#include <utility>    // For std::move
+#include <algorithm>  // For std::min/std::max
+#include <functional> // For std::function
+#include <thread>     // For parallelFor
+#include <atomic>     // For parallelFor work distribution
+#include <exception>  // For forwarding worker exceptions
+#include <memory_resource> // For CountingResource
+
+#ifdef _WIN32
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>  // For CreateFileMapping/MapViewOfFile
+#else
+    #include <fcntl.h>    // For open
+    #include <unistd.h>   // For close
+    #include <sys/mman.h> // For mmap/madvise
+    #include <sys/stat.h> // For fstat
+#endif
 
 namespace oom {
     namespace misc {
         //Forward declarations
         extern const unsigned char DayEnvironmentHDRI019_1K_TONEMAPPED_jpg[]; 
         extern const unsigned int DayEnvironmentHDRI019_1K_TONEMAPPED_jpg_len;
+        class MappedFile;
+        class CountingResource;
+
+        // Read-only memory mapped view of a file
+        // Batch converting hundreds of contentsN.vmaxb files through ifstream::read costs a large allocation
+        // and a copy per file, a mapping lets decoders read straight from the page cache.
+        // The kernel is told we read front to back (madvise sequential) so it reads ahead aggressively.
+        // Move only, the view is unmapped when the MappedFile goes away.
+        class MappedFile {
+        public:
+            MappedFile() = default;
+            explicit MappedFile(const std::string& fileName) { open(fileName); }
+            ~MappedFile() { close(); }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+            MappedFile& operator=(MappedFile&& other) noexcept {
+                if (this != &other) {
+                    close();
+                    ptr = other.ptr; other.ptr = nullptr;
+                    length = other.length; other.length = 0;
+                    discarded = other.discarded; other.discarded = 0;
+                    isOpen = other.isOpen; other.isOpen = false;
+                #ifdef _WIN32
+                    mapping = other.mapping; other.mapping = nullptr;
+                #endif
+                }
+                return *this;
+            }
+
+            // Map a whole file read-only
+            // @return false if the file can't be opened or mapped
+            bool open(const std::string& fileName) {
+                close();
+            #ifdef _WIN32
+                HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                          OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+                if (file == INVALID_HANDLE_VALUE) return false;
+                LARGE_INTEGER fileSize;
+                if (!GetFileSizeEx(file, &fileSize)) {
+                    CloseHandle(file);
+                    return false;
+                }
+                length = static_cast<size_t>(fileSize.QuadPart);
+                if (length > 0) {
+                    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                    if (mapping) {
+                        ptr = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                    }
+                }
+                CloseHandle(file); // the mapping keeps its own reference
+                if (length > 0 && !ptr) {
+                    close();
+                    return false;
+                }
+            #else
+                int fd = ::open(fileName.c_str(), O_RDONLY);
+                if (fd < 0) return false;
+                struct stat fileStat;
+                if (fstat(fd, &fileStat) != 0) {
+                    ::close(fd);
+                    return false;
+                }
+                length = static_cast<size_t>(fileStat.st_size);
+                if (length > 0) {
+                    void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (view == MAP_FAILED) {
+                        ::close(fd);
+                        length = 0;
+                        return false;
+                    }
+                    ptr = static_cast<const uint8_t*>(view);
+                    madvise(view, length, MADV_SEQUENTIAL);
+                    madvise(view, length, MADV_WILLNEED);
+                }
+                ::close(fd); // the mapping stays valid after the descriptor is closed
+            #endif
+                isOpen = true;
+                return true;
+            }
+
+            void close() {
+            #ifdef _WIN32
+                if (ptr) UnmapViewOfFile(ptr);
+                if (mapping) CloseHandle(mapping);
+                mapping = nullptr;
+            #else
+                if (ptr) munmap(const_cast<uint8_t*>(ptr), length);
+            #endif
+                ptr = nullptr;
+                length = 0;
+                discarded = 0;
+                isOpen = false;
+            }
+
+            // Tell the OS the first `upTo` bytes won't be read again so their pages can be dropped
+            // Keeps RSS flat when streaming through a large mapping
+            void discard(size_t upTo) {
+            #ifndef _WIN32
+                const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                upTo = std::min(upTo, length) / pageSize * pageSize;
+                if (ptr && upTo > discarded) {
+                    madvise(const_cast<uint8_t*>(ptr) + discarded, upTo - discarded, MADV_DONTNEED);
+                    discarded = upTo;
+                }
+            #else
+                (void)upTo; // Windows trims clean file backed pages on its own
+            #endif
+            }
+
+            const uint8_t* data() const { return ptr; }
+            size_t size() const { return length; }
+            bool empty() const { return length == 0; }
+            bool is_open() const { return isOpen; }
+
+        private:
+            const uint8_t* ptr = nullptr;
+            size_t length = 0;
+            size_t discarded = 0;
+            bool isOpen = false;
+        #ifdef _WIN32
+            HANDLE mapping = nullptr;
+        #endif
+        };
 
         // Convert sRGB color value to linear color space
         inline float srgbToLinear(float value) {
@@ -19,46 +169,121 @@ namespace oom {
                 std::pow((value + 0.055f) * (1.0f/1.055f), 2.4f);
         }
 
-        // read binary compressed LZFSE file into an array
-        inline std::vector<uint8_t> LZFSEToArray(const std::string& lzfseFullName) {
-                std::ifstream lzfseFile(lzfseFullName, std::ios::binary);
-                if (!lzfseFile.is_open()) {
+        // map binary compressed LZFSE file, decoders can read straight from the returned view
+        inline MappedFile mapLZFSE(const std::string& lzfseFullName) {
+                MappedFile lzfseFile;
+                if (!lzfseFile.open(lzfseFullName)) {
                     std::cerr << "Error: Could not open LZFSE file: " << lzfseFullName << std::endl;
                     throw std::runtime_error("Error message");
                 }
-                // Get file size using std::filesystem
-                size_t lzfseFileSize = std::filesystem::file_size(lzfseFullName);
-                
+                return lzfseFile;
+        }
+
+        // read binary compressed LZFSE file into an array
+        // Prefer mapLZFSE when the bytes don't need to outlive the file
+        inline std::vector<uint8_t> LZFSEToArray(const std::string& lzfseFullName) {
+                MappedFile lzfseFile = mapLZFSE(lzfseFullName);
                 // store the lzfse file in a memory buffer
-                std::vector<uint8_t> lzfseArray(lzfseFileSize);
-                lzfseFile.read(reinterpret_cast<char*>(lzfseArray.data()), lzfseFileSize);
-                lzfseFile.close();
-                return lzfseArray;
+                return std::vector<uint8_t>(lzfseFile.data(), lzfseFile.data() + lzfseFile.size());
         }
 
-        // read binary compressed LZFSE file 
-        // Why not use liblzfse directly?
-        // @param dirName: the name of the directory containing the LZFSE file
-        // @param compressedName: the name of the LZFSE file to decompress
-        inline std::vector<uint8_t> decompressLZFSE(const std::string& dirName, const std::string& compressedName) {
-                std::string lzfseFullName = dirName + "/"+compressedName;
+        // Memory resource that forwards to another one and counts what goes through it
+        // Put one in front of an arena to see what containers ask for, and one behind it to see what the arena takes
+        class CountingResource : public std::pmr::memory_resource {
+        public:
+            explicit CountingResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+                : upstream(upstream) {}
 
-                std::cout << "Decompressing LZFSE file: " << lzfseFullName << std::endl;
-                std::ifstream lzfseFile(lzfseFullName, std::ios::binary);
-                if (!lzfseFile.is_open()) {
-                    std::cerr << "Error: Could not open input file: " << lzfseFullName << std::endl;
-                    throw std::runtime_error("Error message");
+            size_t allocatedBytes() const { return allocated; }                 // everything ever handed out
+            size_t liveBytes() const { return allocated - deallocated; }        // handed out and not given back
+            size_t peakBytes() const { return peak; }
+            size_t allocationCount() const { return allocations; }
+
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override {
+                void* ptr = upstream->allocate(bytes, alignment);
+                size_t live = (allocated += bytes) - deallocated;
+                for (size_t seen = peak; live > seen && !peak.compare_exchange_weak(seen, live);) {}
+                allocations++;
+                return ptr;
+            }
+            void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+                upstream->deallocate(ptr, bytes, alignment);
+                deallocated += bytes;
+            }
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            std::pmr::memory_resource* upstream;
+            std::atomic<size_t> allocated{0};
+            std::atomic<size_t> deallocated{0};
+            std::atomic<size_t> peak{0};
+            std::atomic<size_t> allocations{0};
+        };
+
+        // Number of worker threads to use when a caller asks for 0 ("all of them")
+        inline unsigned defaultThreadCount() {
+            unsigned hardware = std::thread::hardware_concurrency();
+            return hardware ? hardware : 1;
+        }
+
+        // Run body(i) for every i in [0, count) on up to `threads` threads
+        // Indices are handed out one at a time so uneven work balances itself, the calling thread
+        // works too. The first exception thrown by body is rethrown once every worker has stopped.
+        // @param threads: 0 means one per hardware thread
+        inline void parallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& body) {
+            if (threads == 0) threads = defaultThreadCount();
+            if (threads > count) threads = static_cast<unsigned>(count);
+            if (threads <= 1) {
+                for (size_t i = 0; i < count; i++) body(i);
+                return;
+            }
+            std::atomic<size_t> next{0};
+            std::exception_ptr failure;
+            std::atomic<bool> failed{false};
+            auto worker = [&] {
+                try {
+                    for (size_t i = next++; i < count && !failed; i = next++) body(i);
+                } catch (...) {
+                    if (!failed.exchange(true)) failure = std::current_exception();
                 }
+            };
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+            worker();
+            for (auto& thread : pool) thread.join();
+            if (failure) std::rethrow_exception(failure);
+        }
 
-                // Get lzfse file size and read content
-                lzfseFile.seekg(0, std::ios::end);
-                size_t lzfseFileSize = lzfseFile.tellg();
-                lzfseFile.seekg(0, std::ios::beg);
-                // store the lzfse file in a memory buffer
-                std::vector<uint8_t> lzfseBuffer(lzfseFileSize);
-                lzfseFile.read(reinterpret_cast<char*>(lzfseBuffer.data()), lzfseFileSize);
-                lzfseFile.close();
-                return lzfseBuffer;
+        // Sort on up to `threads` threads: equal slices are sorted in parallel, then merged pairwise
+        // Not stable, give equal elements a tie breaker if their order matters
+        // @param threads: 0 means one per hardware thread
+        template <typename T, typename Compare = std::less<T>>
+        inline void parallelSort(std::vector<T>& values, unsigned threads, Compare compare = Compare()) {
+            if (threads == 0) threads = defaultThreadCount();
+            const size_t count = values.size();
+            const size_t slices = std::min<size_t>(threads, std::max<size_t>(1, count / 4096)); // small inputs aren't worth a thread
+            if (slices <= 1) {
+                std::sort(values.begin(), values.end(), compare);
+                return;
+            }
+            std::vector<size_t> bounds(slices + 1);
+            for (size_t i = 0; i <= slices; i++) bounds[i] = count * i / slices;
+            auto at = [&](size_t slice) { return values.begin() + static_cast<std::ptrdiff_t>(bounds[slice]); };
+            parallelFor(slices, threads, [&](size_t i) {
+                std::sort(at(i), at(i + 1), compare);
+            });
+            for (size_t width = 1; width < slices; width *= 2) {
+                const size_t pairs = (slices + 2 * width - 1) / (2 * width);
+                parallelFor(pairs, threads, [&](size_t pair) {
+                    const size_t lo = pair * 2 * width;
+                    const size_t mid = std::min(lo + width, slices);
+                    const size_t hi = std::min(lo + 2 * width, slices);
+                    if (mid < hi) std::inplace_merge(at(lo), at(mid), at(hi), compare);
+                });
+            }
         }
 
         // Function that saves the embedded HDRI file to the res directory
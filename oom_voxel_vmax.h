@@ -9,12 +9,35 @@
 #include <set>          // For set data structure
 #include <vector>       // For dynamic arrays (vectors)
 #include <string>       // For std::string
+#include <array>        // For fixed-size arrays (materials, colors)
 #include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For memcmp/strlen on raw plist bytes
+#include <stdexcept>    // For std::runtime_error
+#include <initializer_list> // For nested plist key paths
+#include <atomic>       // For decode counters
+#include <algorithm>    // For std::min/std::max/std::fill
+#include <optional>     // For optional load settings
+#include <mutex>        // For building the spatial index on demand
+#include <memory_resource> // For Model allocators
+#include <unordered_map> // For the World brick hash
+#include <cmath>        // For std::lround
+#include <iterator>     // For BucketVoxels::iterator
 #include <fstream>      // For file operations (reading/writing files)
 #include <iostream>     // For input/output operations (cout, cin, etc.)
 #include <filesystem>   // For file system operations (directory handling, path manipulation)
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #include <immintrin.h>  // For BMI2/AVX2 Morton decoding
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h> // For __cpuid/__cpuidex
+    #else
+        #include <cpuid.h>  // For __get_cpuid, vendor and family checks
+    #endif
+#endif
+
 #include "../lzfse/src/lzfse.h"
+#include "oom_misc.h"   // For MappedFile
+#include "oom_lzfse_block.h" // For the LZFSE block headers
 #include "../libplist/include/plist/plist.h" // Library for handling Apple property list files
 #include "thirdparty/json.hpp"
 
@@ -39,23 +62,37 @@ namespace oom {
         //struct VoxelGrid;
         struct Model;
         struct ChunkInfo;
-        inline std::vector<Voxel> decodeVoxels(const std::vector<uint8_t>& dsData, int mortonOffset, uint16_t chunkID);
+        template <typename T> struct Span;
+        using ByteSpan = Span<const uint8_t>;
+        inline std::vector<Voxel> decodeVoxels(ByteSpan dsData, int mortonOffset, uint16_t chunkID);
 
         // Useful plist functions
 
         // Read plist file
         inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist, bool decompress);
         inline plist_t readPlist(const std::string& inStrPlist, bool decompress);
+        struct PlistBuffer;
+        inline PlistBuffer readPlistBytes(const std::string& inStrPlist, std::string outStrPlist, bool decompress);
+        inline PlistBuffer readPlistBytes(const std::string& inStrPlist, bool decompress);
+
+        // Zero-copy bplist00 access, see BPlist
+        class BPlist;
+        struct SnapshotView;
+        inline std::vector<SnapshotView> getSnapshots(const BPlist& bplist);
 
         inline std::array<Material, 8> getMaterials(plist_t pnodPalettePlist);
         plist_t getNestedPlistNode(plist_t plist_root, const std::vector<std::string>& path);
         ChunkInfo chunkInfo(const plist_t& plist_snapshot_dict_item);
+        inline ChunkInfo vmaxChunkInfo(const SnapshotView& snapshot);
+        inline std::vector<size_t> latestSnapshots(const std::vector<SnapshotView>& snapshots, size_t& skipped);
         std::vector<Voxel> vmaxVoxelInfo(plist_t& plist_datastream, uint64_t chunkID, uint64_t minMorton);
+        inline std::vector<Voxel> vmaxVoxelInfo(ByteSpan datastream, uint64_t chunkID, uint64_t minMorton);
 
         // Use these to parse scene.json
         struct JsonModelInfo;
         struct JsonGroupInfo;
         class JsonSceneParser;
+        class World;
 
         // Structure to represent a 4x4 matrix for 3D transformations
         // The matrix is stored as a 2D array where m[i][j] represents row i, column j
@@ -210,6 +247,52 @@ namespace oom {
             return palette;
         }
 
+        // Non-owning view over contiguous memory, stand-in for C++20 std::span
+        // Used to hand out slices of a decoded plist buffer without copying them
+        template <typename T>
+        struct Span {
+            T* ptr = nullptr;
+            size_t len = 0;
+
+            Span() = default;
+            Span(T* _ptr, size_t _len) : ptr(_ptr), len(_len) {}
+            // Allow passing a std::vector (or any contiguous container) where a Span is expected
+            template <typename Container,
+                      typename = decltype(std::declval<Container&>().data()),
+                      typename = decltype(std::declval<Container&>().size())>
+            Span(Container& container) : ptr(container.data()), len(container.size()) {}
+
+            T* data() const { return ptr; }
+            size_t size() const { return len; }
+            bool empty() const { return len == 0; }
+            T* begin() const { return ptr; }
+            T* end() const { return ptr + len; }
+            T& operator[](size_t i) const { return ptr[i]; }
+        };
+
+        // Everything decodeVoxels needs from a single snapshot, pointing into the BPlist buffer
+        struct SnapshotView {
+            int64_t id;             // s.id.c, -1 when the snapshot is unusable
+            uint64_t type;          // s.id.t
+            uint64_t mortoncode;    // s.st.min[3]
+            ByteSpan ds;            // s.ds, material/color byte pairs
+        };
+
+        // Axis aligned box in model space, bounds are inclusive
+        struct VoxelBox {
+            uint8_t minx = 0, miny = 0, minz = 0;
+            uint8_t maxx = 255, maxy = 255, maxz = 255;
+
+            bool contains(uint8_t x, uint8_t y, uint8_t z) const {
+                return x >= minx && x <= maxx && y >= miny && y <= maxy && z >= minz && z <= maxz;
+            }
+            bool intersects(const VoxelBox& other) const {
+                return minx <= other.maxx && other.minx <= maxx &&
+                       miny <= other.maxy && other.miny <= maxy &&
+                       minz <= other.maxz && other.minz <= maxz;
+            }
+        };
+
         // Standard useful voxel structure, maps easily to VoxelMax's voxel structure and probably MagicaVoxel's
         // We are using this to unpack a chunked voxel into a simple giant voxel
         // using a uint8_t saves memory over a uint32_t and both VM and MV models are 256x256x256
@@ -234,6 +317,17 @@ namespace oom {
             }
         };
 
+        // Compact voxel, 4 bytes: x | y << 8 | z << 16 | flags << 24
+        // Material and color are implied by the bucket it sits in, flags are free for consumers and 0 after a load
+        using PackedVoxel = uint32_t;
+        inline PackedVoxel packVoxel(uint8_t x, uint8_t y, uint8_t z, uint8_t flags = 0) {
+            return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 8) | (static_cast<uint32_t>(z) << 16) | (static_cast<uint32_t>(flags) << 24);
+        }
+        inline uint8_t packedX(PackedVoxel v) { return static_cast<uint8_t>(v); }
+        inline uint8_t packedY(PackedVoxel v) { return static_cast<uint8_t>(v >> 8); }
+        inline uint8_t packedZ(PackedVoxel v) { return static_cast<uint8_t>(v >> 16); }
+        inline uint8_t packedFlags(PackedVoxel v) { return static_cast<uint8_t>(v >> 24); }
+
         inline uint32_t compactBits(uint32_t n) {
             // For a 32-bit integer in C++
             n &= 0x49249249;                     // Keep only every 3rd bit
@@ -251,15 +345,459 @@ namespace oom {
             z = compactBits(morton >> 2);
         }
 
+        // Inverse of compactBits, spreads the low 10 bits of n to every 3rd bit
+        inline uint32_t spreadBits(uint32_t n) {
+            n &= 0x000003ff;
+            n = (n ^ (n << 16)) & 0xff0000ff;
+            n = (n ^ (n << 8)) & 0x0300f00f;
+            n = (n ^ (n << 4)) & 0x030c30c3;
+            n = (n ^ (n << 2)) & 0x09249249;
+            return n;
+        }
+
+        // Morton encode x y z, x in the lowest bit like decodeMorton3DOptimized expects
+        inline uint32_t encodeMorton3D(uint32_t x, uint32_t y, uint32_t z) {
+            return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+        }
+
+        // Back to a full Voxel, chunkID is rebuilt from the position and minMorton is 0
+        inline Voxel unpackVoxel(PackedVoxel v, uint8_t material, uint8_t color) {
+            return Voxel(packedX(v), packedY(v), packedZ(v), material, color,
+                         static_cast<uint16_t>(encodeMorton3D(packedX(v) >> 5, packedY(v) >> 5, packedZ(v) >> 5)), 0);
+        }
+
+        // The voxels of one (material, color) bucket in either storage mode, see Model::getVoxels
+        // Elements are Voxel values, packed ones are expanded with unpackVoxel as they are read, so
+        // `for (const Voxel& v : model.getVoxels(m, c))` works on any model. Use unpacked()/packed()
+        // to get at the storage directly.
+        class BucketVoxels {
+        public:
+            class iterator {
+            public:
+                using iterator_category = std::input_iterator_tag;
+                using value_type = Voxel;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = Voxel;
+
+                iterator(const Voxel* _voxel, const PackedVoxel* _packed, uint8_t _material, uint8_t _color)
+                    : voxel(_voxel), packed(_packed), material(_material), color(_color) {}
+                Voxel operator*() const { return packed ? unpackVoxel(*packed, material, color) : *voxel; }
+                iterator& operator++() {
+                    if (packed) packed++;
+                    else voxel++;
+                    return *this;
+                }
+                bool operator==(const iterator& other) const { return voxel == other.voxel && packed == other.packed; }
+                bool operator!=(const iterator& other) const { return !(*this == other); }
+
+            private:
+                const Voxel* voxel;
+                const PackedVoxel* packed;
+                uint8_t material, color;
+            };
+
+            BucketVoxels() = default;
+            BucketVoxels(Span<const Voxel> voxels) : voxelSpan(voxels) {}
+            BucketVoxels(Span<const PackedVoxel> packedSpan, uint8_t _material, uint8_t _color)
+                : packedVoxels(packedSpan), isPackedBucket(true), material(_material), color(_color) {}
+            // Allow passing a std::vector<Voxel> (or any contiguous container) where a bucket is expected
+            template <typename Container,
+                      typename = decltype(std::declval<const Container&>().data()),
+                      typename = decltype(std::declval<const Container&>().size())>
+            BucketVoxels(const Container& container) : voxelSpan(container.data(), container.size()) {}
+
+            size_t size() const { return isPackedBucket ? packedVoxels.size() : voxelSpan.size(); }
+            bool empty() const { return size() == 0; }
+            Voxel operator[](size_t i) const { return isPackedBucket ? unpackVoxel(packedVoxels[i], material, color) : voxelSpan[i]; }
+            iterator begin() const {
+                return isPackedBucket ? iterator(nullptr, packedVoxels.begin(), material, color) : iterator(voxelSpan.begin(), nullptr, 0, 0);
+            }
+            iterator end() const {
+                return isPackedBucket ? iterator(nullptr, packedVoxels.end(), material, color) : iterator(voxelSpan.end(), nullptr, 0, 0);
+            }
+
+            bool isPacked() const { return isPackedBucket; }
+            Span<const Voxel> unpacked() const { return voxelSpan; }       // empty when isPacked()
+            Span<const PackedVoxel> packed() const { return packedVoxels; } // empty unless isPacked()
+
+        private:
+            Span<const Voxel> voxelSpan;
+            Span<const PackedVoxel> packedVoxels;
+            bool isPackedBucket = false;
+            uint8_t material = 0, color = 0;
+        };
+
+        // Batch Morton decoding
+        // ---------------------
+        // decodeMorton3DOptimized runs compactBits 3 times per voxel, 5 shift/mask steps each.
+        // The batch decoder below turns N 24 bit codes (8 bits per axis, a whole 256x256x256 model)
+        // into SoA x/y/z arrays and picks the fastest implementation once, on first use:
+        //   BMI2   _pext_u32 pulls each axis out in a single instruction, where pext is not microcoded
+        //   AVX2   8 codes at a time through gathers on the lookup table
+        //   table  constexpr 512 entry table, 3 lookups per code, portable fallback
+        // Note: pext is microcoded on AMD before Zen3 (family 0x19), slower than the table there, so the
+        // BMI2 path is only taken when cpuHasFastPEXT() says so. OOM_VMAX_NO_PEXT still forces it off
+
+        // 9 bits of a code (3 per axis) -> x | y << 8 | z << 16, 3 bits per field
+        inline constexpr std::array<uint32_t, 512> makeMortonDecodeTable() {
+            std::array<uint32_t, 512> table{};
+            for (uint32_t i = 0; i < 512; i++) {
+                uint32_t x = 0, y = 0, z = 0;
+                for (uint32_t bit = 0; bit < 3; bit++) {
+                    x |= ((i >> (3 * bit)) & 1) << bit;
+                    y |= ((i >> (3 * bit + 1)) & 1) << bit;
+                    z |= ((i >> (3 * bit + 2)) & 1) << bit;
+                }
+                table[i] = x | (y << 8) | (z << 16);
+            }
+            return table;
+        }
+        inline constexpr std::array<uint32_t, 512> mortonDecodeTable = makeMortonDecodeTable();
+
+        // Table decode of a single 24 bit code, packed as x | y << 8 | z << 16
+        inline uint32_t decodeMorton3DPacked(uint32_t morton) {
+            return mortonDecodeTable[morton & 511] |
+                   (mortonDecodeTable[(morton >> 9) & 511] << 3) |
+                   (mortonDecodeTable[(morton >> 18) & 63] << 6);   // top 6 bits, only 2 per axis left
+        }
+
+        inline void decodeMorton3DBatchTable(const uint32_t* codes, size_t count, uint8_t* xs, uint8_t* ys, uint8_t* zs) {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t packed = decodeMorton3DPacked(codes[i]);
+                xs[i] = static_cast<uint8_t>(packed);
+                ys[i] = static_cast<uint8_t>(packed >> 8);
+                zs[i] = static_cast<uint8_t>(packed >> 16);
+            }
+        }
+
+    #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        #define OOM_VMAX_X86 1
+        #if defined(_MSC_VER) && !defined(__clang__)
+            #define OOM_VMAX_TARGET(isa)   // MSVC lets intrinsics through without a target attribute
+        #else
+            #define OOM_VMAX_TARGET(isa) __attribute__((target(isa)))
+        #endif
+
+        OOM_VMAX_TARGET("bmi2")
+        inline void decodeMorton3DBatchBMI2(const uint32_t* codes, size_t count, uint8_t* xs, uint8_t* ys, uint8_t* zs) {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t morton = codes[i];
+                xs[i] = static_cast<uint8_t>(_pext_u32(morton, 0x00249249));
+                ys[i] = static_cast<uint8_t>(_pext_u32(morton, 0x00492492));
+                zs[i] = static_cast<uint8_t>(_pext_u32(morton, 0x00924924));
+            }
+        }
+
+        OOM_VMAX_TARGET("avx2")
+        inline void decodeMorton3DBatchAVX2(const uint32_t* codes, size_t count, uint8_t* xs, uint8_t* ys, uint8_t* zs) {
+            const int* table = reinterpret_cast<const int*>(mortonDecodeTable.data());
+            const __m256i low9 = _mm256_set1_epi32(511);
+            const __m256i top6 = _mm256_set1_epi32(63);
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i morton = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i));
+                __m256i lo  = _mm256_i32gather_epi32(table, _mm256_and_si256(morton, low9), 4);
+                __m256i mid = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(morton, 9), low9), 4);
+                __m256i hi  = _mm256_i32gather_epi32(table, _mm256_and_si256(_mm256_srli_epi32(morton, 18), top6), 4);
+                __m256i packed = _mm256_or_si256(lo, _mm256_or_si256(_mm256_slli_epi32(mid, 3), _mm256_slli_epi32(hi, 6)));
+                alignas(32) uint32_t lanes[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), packed);
+                for (int lane = 0; lane < 8; lane++) {
+                    xs[i + lane] = static_cast<uint8_t>(lanes[lane]);
+                    ys[i + lane] = static_cast<uint8_t>(lanes[lane] >> 8);
+                    zs[i + lane] = static_cast<uint8_t>(lanes[lane] >> 16);
+                }
+            }
+            decodeMorton3DBatchTable(codes + i, count - i, xs + i, ys + i, zs + i);
+        }
+
+        inline bool cpuHasBMI2() {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 8)) != 0;
+        #else
+            return __builtin_cpu_supports("bmi2");
+        #endif
+        }
+
+        // BMI2 with a hardware pext, ie not AMD/Hygon before family 0x19 (Zen1/Zen2 run it in microcode)
+        inline bool cpuHasFastPEXT() {
+            if (!cpuHasBMI2()) return false;
+            unsigned int regs[4] = {0, 0, 0, 0};    // eax, ebx, ecx, edx
+        #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(info[i]);
+        #else
+            if (!__get_cpuid(0, &regs[0], &regs[1], &regs[2], &regs[3])) return false;
+        #endif
+            char vendor[13] = {};
+            std::memcpy(vendor, &regs[1], 4);
+            std::memcpy(vendor + 4, &regs[3], 4);
+            std::memcpy(vendor + 8, &regs[2], 4);
+            if (std::strcmp(vendor, "AuthenticAMD") != 0 && std::strcmp(vendor, "HygonGenuine") != 0) return true;
+        #if defined(_MSC_VER) && !defined(__clang__)
+            __cpuid(info, 1);
+            regs[0] = static_cast<unsigned int>(info[0]);
+        #else
+            if (!__get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3])) return false;
+        #endif
+            unsigned int family = (regs[0] >> 8) & 0xf;
+            if (family == 0xf) family += (regs[0] >> 20) & 0xff;
+            return family >= 0x19;
+        }
+
+        inline bool cpuHasAVX2() {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 1);
+            bool osSavesYmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 6) == 6);
+            __cpuidex(info, 7, 0);
+            return osSavesYmm && (info[1] & (1 << 5)) != 0;
+        #else
+            return __builtin_cpu_supports("avx2");
+        #endif
+        }
+    #endif
+
+        using MortonBatchFn = void (*)(const uint32_t* codes, size_t count, uint8_t* xs, uint8_t* ys, uint8_t* zs);
+
+        // Pick the batch decoder for this CPU
+        // @param name: receives the implementation name, handy for benchmarks and logs
+        inline MortonBatchFn selectMortonBatchDecoder(const char** name = nullptr) {
+            const char* chosen = "table";
+            MortonBatchFn fn = decodeMorton3DBatchTable;
+        #ifdef OOM_VMAX_X86
+            #ifndef OOM_VMAX_NO_PEXT
+            if (cpuHasFastPEXT()) {
+                chosen = "bmi2";
+                fn = decodeMorton3DBatchBMI2;
+            } else
+            #endif
+            if (cpuHasAVX2()) {
+                chosen = "avx2";
+                fn = decodeMorton3DBatchAVX2;
+            }
+        #endif
+            if (name) *name = chosen;
+            return fn;
+        }
+
+        /**
+        * Decode `count` 24 bit Morton codes into SoA coordinate arrays
+        * Codes above 24 bits are truncated, a model is at most 256x256x256
+        * 
+        * @param codes Morton codes, interleaved as ...zyxzyx
+        * @param count number of codes
+        * @param xs, ys, zs output arrays of at least `count` entries
+        */
+        inline void decodeMorton3DBatch(const uint32_t* codes, size_t count, uint8_t* xs, uint8_t* ys, uint8_t* zs) {
+            static const MortonBatchFn decoder = selectMortonBatchDecoder();
+            decoder(codes, count, xs, ys, zs);
+        }
+
+        // Z-order of a model space position, 24 bits
+        inline uint32_t voxelMorton(uint8_t x, uint8_t y, uint8_t z) {
+            return encodeMorton3D(x, y, z);
+        }
+
+        /**
+        * Stable LSD radix sort on a 24 bit field, 3 passes of 8 bits
+        * Passes where every value has the same digit are skipped.
+        * 
+        * @param values sorted in place, bits outside the field ride along as payload
+        * @param shift position of the field, ie 32 for a Morton code stored as morton << 32 | payload
+        */
+        inline void radixSort24(std::vector<uint64_t>& values, unsigned shift) {
+            std::vector<uint64_t> scratch(values.size());
+            for (unsigned pass = 0; pass < 3; pass++) {
+                const unsigned bits = shift + pass * 8;
+                size_t count[256] = {};
+                for (uint64_t v : values) count[(v >> bits) & 255]++;
+                if (values.empty() || count[(values[0] >> bits) & 255] == values.size()) continue;
+                size_t sum = 0;
+                for (size_t& c : count) {
+                    size_t n = c;
+                    c = sum;
+                    sum += n;
+                }
+                for (uint64_t v : values) scratch[count[(v >> bits) & 255]++] = v;
+                values.swap(scratch);
+            }
+        }
+
+        // Reorder one bucket into Morton order, voxels at the same position keep their order
+        template <typename Bucket>
+        inline void sortVoxelsByMorton(Bucket& bucket) {
+            std::vector<uint64_t> keys(bucket.size());
+            for (size_t i = 0; i < bucket.size(); i++) {
+                keys[i] = (uint64_t(voxelMorton(bucket[i].x, bucket[i].y, bucket[i].z)) << 32) | i;
+            }
+            radixSort24(keys, 32);
+            Bucket sorted(bucket.get_allocator());
+            sorted.reserve(bucket.size());
+            for (uint64_t key : keys) sorted.push_back(bucket[static_cast<uint32_t>(key)]);
+            bucket = std::move(sorted);
+        }
+
+        inline int popcount32(uint32_t n) {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            return static_cast<int>(__popcnt(n));
+        #else
+            return __builtin_popcount(n);
+        #endif
+        }
+
+        // Index of the lowest set bit, n must not be 0
+        inline int lowestBit32(uint32_t n) {
+        #if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, n);
+            return static_cast<int>(index);
+        #else
+            return __builtin_ctz(n);
+        #endif
+        }
+
+        // Occupancy of 32 consecutive material/color pairs (64 bytes of a ds stream)
+        // Bit i is set when pair i has a non-zero color, color 0 means no voxel
+        inline uint32_t occupiedPairMask32(const uint8_t* pairs) {
+        #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            // Each pair is a little endian 16 bit lane with the color in the high byte,
+            // shift the colors down, pack 16 pairs into 16 bytes and compare against zero
+            const __m128i zero = _mm_setzero_si128();
+            __m128i p0 = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs)), 8);
+            __m128i p1 = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs + 16)), 8);
+            __m128i p2 = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs + 32)), 8);
+            __m128i p3 = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pairs + 48)), 8);
+            uint32_t emptyLo = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_packus_epi16(p0, p1), zero)));
+            uint32_t emptyHi = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_packus_epi16(p2, p3), zero)));
+            return ~(emptyLo | (emptyHi << 16));
+        #else
+            // SWAR fallback, 4 pairs per 64 bit word (assumes little endian like every vmax host)
+            uint32_t mask = 0;
+            for (int word = 0; word < 8; word++) {
+                uint64_t w;
+                std::memcpy(&w, pairs + word * 8, 8);
+                uint64_t colors = (w >> 8) & 0x00ff00ff00ff00ffull;                                // color per 16 bit lane
+                uint64_t nonzero = ((colors + 0x00ff00ff00ff00ffull) >> 8) & 0x0001000100010001ull; // carry iff color != 0
+                uint32_t bits = static_cast<uint32_t>((nonzero | (nonzero >> 15) | (nonzero >> 30) | (nonzero >> 45)) & 0xf);
+                mask |= bits << (word * 4);
+            }
+            return mask;
+        #endif
+        }
+
+        /**
+        * Visit every occupied slot of a ds stream, empty slots are skipped 32 at a time
+        * 
+        * @param dsData material/color byte pairs, slot index is the pair index
+        * @param visit called as visit(slotIndex, material, color) in slot order
+        */
+        template <typename Visit>
+        inline void forEachOccupiedSlot(ByteSpan dsData, Visit&& visit) {
+            const uint8_t* pairs = dsData.data();
+            const size_t slotCount = dsData.size() / 2;
+            size_t slot = 0;
+            for (; slot + 32 <= slotCount; slot += 32) {
+                uint32_t mask = occupiedPairMask32(pairs + slot * 2);
+                while (mask) {
+                    size_t index = slot + lowestBit32(mask);
+                    mask &= mask - 1;
+                    visit(index, pairs[index * 2], pairs[index * 2 + 1]);
+                }
+            }
+            for (; slot < slotCount; slot++) { // tail shorter than 32 pairs
+                if (pairs[slot * 2 + 1] != 0) {
+                    visit(slot, pairs[slot * 2], pairs[slot * 2 + 1]);
+                }
+            }
+        }
+
+        /**
+        * Visit every voxel of a snapshot at its final model coordinate
+        * Shared by Model::addSnapshot and the parallel loader so both produce identical voxels
+        * 
+        * @param dsData material/color pairs of the snapshot
+        * @param chunkID s.id.c, Morton index of the 32x32x32 chunk in the 8x8x8 chunk grid
+        * @param minMorton s.st.min[3], Morton offset of the snapshot inside its chunk
+        * @param visit called as visit(x, y, z, material, color) in slot order, materials >= 8 are dropped
+        */
+        template <typename Visit>
+        inline void forEachSnapshotVoxel(ByteSpan dsData, uint64_t chunkID, uint64_t minMorton, Visit&& visit) {
+            // Chunk origin in model space, 32 voxels per chunk
+            const uint32_t chunkOrigin = decodeMorton3DPacked(static_cast<uint32_t>(chunkID) & 511) * 32; // 8x8x8 chunk grid
+            forEachOccupiedSlot(dsData, [&](size_t slot, uint8_t material, uint8_t color) {
+                if (material >= 8) return;
+                uint32_t local = decodeMorton3DPacked(static_cast<uint32_t>(slot + minMorton)); // index IS the morton code
+                // per axis byte add, coordinates wrap at 256 like the uint8_t Voxel fields always did
+                visit(static_cast<uint8_t>(local + chunkOrigin),
+                      static_cast<uint8_t>((local >> 8) + (chunkOrigin >> 8)),
+                      static_cast<uint8_t>((local >> 16) + (chunkOrigin >> 16)),
+                      material, color);
+            });
+        }
+
+        /**
+        * Conservative model space bounds of a snapshot, from its header alone
+        * The slots cover the Morton range [minMorton, minMorton + slots), which lies inside the
+        * smallest aligned octree node sharing the common prefix of both ends.
+        * 
+        * @param slotCount number of material/color pairs, ds.size() / 2
+        * @param chunkID s.id.c
+        * @param minMorton s.st.min[3]
+        * @param box set to the bounds
+        * @return false for an empty snapshot
+        */
+        inline bool snapshotBounds(size_t slotCount, uint64_t chunkID, uint64_t minMorton, VoxelBox& box) {
+            if (slotCount == 0) return false;
+            const uint64_t first = minMorton;
+            const uint64_t last = minMorton + slotCount - 1;
+            if (last >= 32 * 32 * 32) {
+                // Runs past the end of its chunk and wraps, don't guess
+                box = VoxelBox{};
+                return true;
+            }
+            unsigned bits = 0;
+            while ((first ^ last) >> bits) bits += 3;
+            const uint32_t size = 1u << (bits / 3);
+            const uint32_t node = decodeMorton3DPacked(static_cast<uint32_t>(first & ~((uint64_t(1) << bits) - 1)));
+            const uint32_t origin = decodeMorton3DPacked(static_cast<uint32_t>(chunkID) & 511) * 32 + node;
+            box.minx = static_cast<uint8_t>(origin);
+            box.miny = static_cast<uint8_t>(origin >> 8);
+            box.minz = static_cast<uint8_t>(origin >> 16);
+            box.maxx = static_cast<uint8_t>(box.minx + size - 1);
+            box.maxy = static_cast<uint8_t>(box.miny + size - 1);
+            box.maxz = static_cast<uint8_t>(box.minz + size - 1);
+            return true;
+        }
+
+        // Number of voxels (non-zero colors) in a ds stream, used to size outputs up front
+        inline size_t countOccupiedSlots(ByteSpan dsData) {
+            const uint8_t* pairs = dsData.data();
+            const size_t slotCount = dsData.size() / 2;
+            size_t count = 0;
+            size_t slot = 0;
+            for (; slot + 32 <= slotCount; slot += 32) {
+                count += popcount32(occupiedPairMask32(pairs + slot * 2));
+            }
+            for (; slot < slotCount; slot++) {
+                count += pairs[slot * 2 + 1] != 0;
+            }
+            return count;
+        }
+
         struct Material {
             std::string materialName;
-            double transmission;
-            double roughness;
-            double metalness;
-            double emission;
-            bool enableShadows;
-            bool dielectric; // future use
-            bool volumetric; // future use
+            double transmission = 0.0;  // defaults so a model without a palette reads as opaque
+            double roughness = 0.0;
+            double metalness = 0.0;
+            double emission = 0.0;
+            bool enableShadows = true;
+            bool dielectric = false; // future use
+            bool volumetric = false; // future use
         };
 
         /*struct VoxelGrid {
@@ -270,6 +808,497 @@ namespace oom {
         };*/
 
 
+        // What a spatial lookup returns: the voxel at a position, if any
+        // Looks enough like the old const std::vector<Voxel>& (size/empty/[]/range for) that callers keep working
+        struct VoxelsAt {
+            Voxel voxel{0, 0, 0, 0, 0, 0, 0};
+            uint8_t count = 0;  // 0 or 1
+
+            size_t size() const { return count; }
+            bool empty() const { return count == 0; }
+            const Voxel* begin() const { return &voxel; }
+            const Voxel* end() const { return &voxel + count; }
+            const Voxel& operator[](size_t) const { return voxel; }
+            const Voxel& front() const { return voxel; }
+        };
+
+        // Two level sparse grid over the 256x256x256 model space
+        // A 32x32x32 table of brick indices on top, dense 8x8x8 bricks of (palette, material) below.
+        // O(1) lookups, 2 bytes per cell inside a brick and neighbors along x are adjacent in memory.
+        // One voxel per position, the last write wins. Palette 0 marks an empty cell like in vmax.
+        class BrickMap {
+        public:
+            struct Cell {
+                uint8_t palette = 0;
+                uint8_t material = 0;
+            };
+            static constexpr uint32_t brickSize = 8;
+            static constexpr uint32_t gridSize = 256 / brickSize;
+            static constexpr uint32_t cellsPerBrick = brickSize * brickSize * brickSize;
+            using Brick = std::array<Cell, cellsPerBrick>;
+
+            void set(uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t palette) {
+                if (top.empty()) top.assign(gridSize * gridSize * gridSize, 0);
+                uint32_t& slot = top[brickIndex(x, y, z)];
+                if (slot == 0) {
+                    bricks.emplace_back();
+                    slot = static_cast<uint32_t>(bricks.size());   // stored +1, 0 means no brick
+                }
+                Cell& cell = bricks[slot - 1][cellIndex(x, y, z)];
+                if (cell.palette == 0 && palette != 0) occupied++;
+                else if (cell.palette != 0 && palette == 0) occupied--;
+                cell.palette = palette;
+                cell.material = material;
+            }
+
+            Cell get(uint8_t x, uint8_t y, uint8_t z) const {
+                if (top.empty()) return Cell{};
+                uint32_t slot = top[brickIndex(x, y, z)];
+                return slot ? bricks[slot - 1][cellIndex(x, y, z)] : Cell{};
+            }
+
+            bool has(uint8_t x, uint8_t y, uint8_t z) const {
+                return get(x, y, z).palette != 0;
+            }
+
+            // Brick holding (x, y, z) or nullptr, for walking neighbors without repeating the top lookup
+            const Brick* brickAt(uint8_t x, uint8_t y, uint8_t z) const {
+                if (top.empty()) return nullptr;
+                uint32_t slot = top[brickIndex(x, y, z)];
+                return slot ? &bricks[slot - 1] : nullptr;
+            }
+
+            void clear() {
+                top.clear();
+                bricks.clear();
+                occupied = 0;
+            }
+
+            // Bulk building: allocate bricks up front, fill them through brickFor (from several
+            // threads if they touch different bricks), then recount()
+            void allocateBricks(const std::vector<uint32_t>& brickIndices) {
+                if (top.empty()) top.assign(gridSize * gridSize * gridSize, 0);
+                bricks.reserve(bricks.size() + brickIndices.size());
+                for (uint32_t index : brickIndices) {
+                    if (top[index] == 0) {
+                        bricks.emplace_back();
+                        top[index] = static_cast<uint32_t>(bricks.size());
+                    }
+                }
+            }
+            Brick& brickFor(uint32_t brickIndex) {
+                return bricks[top[brickIndex] - 1];
+            }
+            void recount() {
+                occupied = 0;
+                for (const Brick& brick : bricks) {
+                    for (const Cell& cell : brick) occupied += cell.palette != 0;
+                }
+            }
+
+            size_t size() const { return occupied; }
+            bool empty() const { return occupied == 0; }
+            size_t brickCount() const { return bricks.size(); }
+            size_t memoryBytes() const { return top.capacity() * sizeof(uint32_t) + bricks.capacity() * sizeof(Brick); }
+
+            static uint32_t brickIndex(uint8_t x, uint8_t y, uint8_t z) {
+                return (static_cast<uint32_t>(z >> 3) * gridSize + (y >> 3)) * gridSize + (x >> 3);
+            }
+            static uint32_t cellIndex(uint8_t x, uint8_t y, uint8_t z) {
+                return ((z & 7u) * brickSize + (y & 7u)) * brickSize + (x & 7u);
+            }
+
+        private:
+            std::vector<uint32_t> top;      // gridSize^3 brick indices + 1, allocated on first set
+            std::vector<Brick> bricks;
+            size_t occupied = 0;
+        };
+
+        // One bit per voxel over the whole 256x256x256 model space, 2 MiB
+        // A (y, z) row is 4 uint64 words along x, bit x & 63 of word x >> 6. Face queries work on whole
+        // words: along x the row is shifted by one bit with carry between words, along y and z the
+        // neighbor is simply another row. 64 voxels per operation, the 4 word loops vectorize.
+        // Outside the model counts as empty, so voxels on the border are exposed.
+        class OccupancyGrid {
+        public:
+            static constexpr uint32_t wordsPerRow = 256 / 64;
+            enum Face { NegX, PosX, NegY, PosY, NegZ, PosZ };
+
+            void set(uint8_t x, uint8_t y, uint8_t z) {
+                if (bits.empty()) bits.assign(size_t(256) * 256 * wordsPerRow, 0);
+                bits[wordIndex(y, z) + (x >> 6)] |= uint64_t(1) << (x & 63);
+            }
+            void reset(uint8_t x, uint8_t y, uint8_t z) {
+                if (bits.empty()) return;
+                bits[wordIndex(y, z) + (x >> 6)] &= ~(uint64_t(1) << (x & 63));
+            }
+            bool test(uint8_t x, uint8_t y, uint8_t z) const {
+                return !bits.empty() && ((bits[wordIndex(y, z) + (x >> 6)] >> (x & 63)) & 1);
+            }
+            void clear() {
+                std::vector<uint64_t>().swap(bits);
+            }
+            bool empty() const { return bits.empty(); }
+            size_t memoryBytes() const { return bits.capacity() * sizeof(uint64_t); }
+
+            // The 4 words of a row, nullptr while nothing is set
+            const uint64_t* row(uint8_t y, uint8_t z) const {
+                return bits.empty() ? nullptr : &bits[wordIndex(y, z)];
+            }
+
+            // Occupied voxels of row (y, z) whose neighbor on `face` is empty, one bit per voxel
+            void exposedRow(uint8_t y, uint8_t z, Face face, uint64_t out[wordsPerRow]) const {
+                static const uint64_t none[wordsPerRow] = {};
+                const uint64_t* self = bits.empty() ? none : &bits[wordIndex(y, z)];
+                uint64_t neighbor[wordsPerRow];
+                switch (face) {
+                    case PosX:  // neighbor of x is x + 1, shift the row down a bit, carry from the next word
+                        for (uint32_t i = 0; i < wordsPerRow; i++) {
+                            neighbor[i] = (self[i] >> 1) | (i + 1 < wordsPerRow ? self[i + 1] << 63 : 0);
+                        }
+                        break;
+                    case NegX:
+                        for (uint32_t i = 0; i < wordsPerRow; i++) {
+                            neighbor[i] = (self[i] << 1) | (i > 0 ? self[i - 1] >> 63 : 0);
+                        }
+                        break;
+                    default: {
+                        const uint64_t* other = neighborRow(y, z, face);
+                        if (!other) other = none;
+                        for (uint32_t i = 0; i < wordsPerRow; i++) neighbor[i] = other[i];
+                        break;
+                    }
+                }
+                for (uint32_t i = 0; i < wordsPerRow; i++) out[i] = self[i] & ~neighbor[i];
+            }
+
+            // Occupied voxels of row (y, z) with at least one empty neighbor
+            void exposedRowAny(uint8_t y, uint8_t z, uint64_t out[wordsPerRow]) const {
+                uint64_t face[wordsPerRow];
+                for (uint32_t i = 0; i < wordsPerRow; i++) out[i] = 0;
+                for (int f = NegX; f <= PosZ; f++) {
+                    exposedRow(y, z, static_cast<Face>(f), face);
+                    for (uint32_t i = 0; i < wordsPerRow; i++) out[i] |= face[i];
+                }
+            }
+
+            bool isExposed(uint8_t x, uint8_t y, uint8_t z, Face face) const {
+                if (!test(x, y, z)) return false;
+                int nx = x + (face == PosX) - (face == NegX);
+                int ny = y + (face == PosY) - (face == NegY);
+                int nz = z + (face == PosZ) - (face == NegZ);
+                if (nx < 0 || nx > 255 || ny < 0 || ny > 255 || nz < 0 || nz > 255) return true;
+                return !test(static_cast<uint8_t>(nx), static_cast<uint8_t>(ny), static_cast<uint8_t>(nz));
+            }
+
+            // Number of occupied voxels
+            size_t count() const {
+                size_t total = 0;
+                for (uint64_t word : bits) total += popcount64(word);
+                return total;
+            }
+
+            // Number of exposed faces over the whole model, ie the face count of a naive mesh
+            size_t exposedFaceCount() const {
+                if (bits.empty()) return 0;
+                size_t total = 0;
+                uint64_t out[wordsPerRow];
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t y = 0; y < 256; y++) {
+                        for (int f = NegX; f <= PosZ; f++) {
+                            exposedRow(static_cast<uint8_t>(y), static_cast<uint8_t>(z), static_cast<Face>(f), out);
+                            for (uint32_t i = 0; i < wordsPerRow; i++) total += popcount64(out[i]);
+                        }
+                    }
+                }
+                return total;
+            }
+
+            static size_t wordIndex(uint8_t y, uint8_t z) {
+                return (static_cast<size_t>(z) * 256 + y) * wordsPerRow;
+            }
+
+            static int popcount64(uint64_t v) {
+                return popcount32(static_cast<uint32_t>(v)) + popcount32(static_cast<uint32_t>(v >> 32));
+            }
+
+        private:
+            const uint64_t* neighborRow(uint8_t y, uint8_t z, Face face) const {
+                switch (face) {
+                    case PosY: return y < 255 ? row(static_cast<uint8_t>(y + 1), z) : nullptr;
+                    case NegY: return y > 0 ? row(static_cast<uint8_t>(y - 1), z) : nullptr;
+                    case PosZ: return z < 255 ? row(y, static_cast<uint8_t>(z + 1)) : nullptr;
+                    case NegZ: return z > 0 ? row(y, static_cast<uint8_t>(z - 1)) : nullptr;
+                    default: return nullptr;
+                }
+            }
+
+            std::vector<uint64_t> bits;     // 256 * 256 rows of wordsPerRow words, allocated on first set
+        };
+
+        // Derived data built on first use, see Model::spatialIndex and Model::occupancy
+        // Copies and moves start out unbuilt, the index is rebuilt from the buckets when needed
+        template <typename Index>
+        struct LazyIndex {
+            Index value;
+            std::atomic<bool> valid{false};
+            std::mutex mutex;
+
+            LazyIndex() = default;
+            LazyIndex(const LazyIndex&) {}
+            LazyIndex& operator=(const LazyIndex&) { invalidate(); return *this; }
+
+            // Build once with build(Index&), safe from several threads
+            template <typename Build>
+            const Index& get(Build&& build) {
+                if (valid.load(std::memory_order_acquire)) return value;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!valid.load(std::memory_order_relaxed)) {
+                    build(value);
+                    valid.store(true, std::memory_order_release);
+                }
+                return value;
+            }
+
+            void invalidate() {
+                if (valid.exchange(false)) value = Index();
+            }
+        };
+
+        // Lower resolution copies of a model for previews and distant instances, see Model::lod
+        // Level 1 is 128^3, level 2 64^3, level 3 32^3, a cell of level L stands for a (2^L)^3 block of the
+        // model. Each cell is the majority (material, color) of the 2x2x2 cells below it, ignoring empty
+        // ones so thin walls survive. If any of them is emissive only emissive cells vote, so lights never
+        // disappear. Ties go to the lowest (material, color). Built a brick at a time, every 8^3 brick
+        // reads the 2x2x2 bricks below it, bricks are independent and built in parallel.
+        class ModelLod {
+        public:
+            static constexpr int levelCount = 3;
+
+            ModelLod() = default;
+            ModelLod(const BrickMap& model, const std::array<Material, 8>& materials, unsigned threads = 0) {
+                build(model, materials, threads ? threads : oom::misc::defaultThreadCount());
+            }
+
+            // Cells of level 1..levelCount, coordinates run 0..(256 >> level) - 1
+            const BrickMap& level(int level) const { return levels[level - 1]; }
+            static uint32_t resolution(int level) { return 256u >> level; }
+            size_t size(int level) const { return levels[level - 1].size(); }
+            size_t memoryBytes() const {
+                size_t total = 0;
+                for (const BrickMap& map : levels) total += map.memoryBytes();
+                return total;
+            }
+
+            /**
+            * Visit every occupied cell of a level
+            * @param visit called as visit(x, y, z, material, color) in level coordinates, brick by brick
+            */
+            template <typename Visit>
+            void forEachVoxel(int level, Visit&& visit) const {
+                const BrickMap& map = levels[level - 1];
+                const uint32_t extent = resolution(level);
+                for (uint32_t bz = 0; bz < extent; bz += BrickMap::brickSize) {
+                    for (uint32_t by = 0; by < extent; by += BrickMap::brickSize) {
+                        for (uint32_t bx = 0; bx < extent; bx += BrickMap::brickSize) {
+                            const BrickMap::Brick* brick = map.brickAt(bx, by, bz);
+                            if (!brick) continue;
+                            for (uint32_t i = 0; i < BrickMap::cellsPerBrick; i++) {
+                                const BrickMap::Cell& cell = (*brick)[i];
+                                if (cell.palette) visit(static_cast<uint8_t>(bx + (i & 7)), static_cast<uint8_t>(by + ((i >> 3) & 7)),
+                                                        static_cast<uint8_t>(bz + (i >> 6)), cell.material, cell.palette);
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            void build(const BrickMap& model, const std::array<Material, 8>& materials, unsigned threads) {
+                bool emissive[8];
+                for (int m = 0; m < 8; m++) emissive[m] = materials[m].emission > 0.0;
+                const BrickMap* source = &model;
+                for (int l = 1; l <= levelCount; l++) {
+                    downsample(*source, levels[l - 1], resolution(l), emissive, threads);
+                    source = &levels[l - 1];
+                }
+            }
+
+            static void downsample(const BrickMap& source, BrickMap& target, uint32_t extent, const bool emissive[8], unsigned threads) {
+                target.clear();
+                // A target brick exists when any of the 2x2x2 source bricks below it does
+                std::vector<uint32_t> brickIndices;
+                for (uint32_t bz = 0; bz < extent; bz += BrickMap::brickSize) {
+                    for (uint32_t by = 0; by < extent; by += BrickMap::brickSize) {
+                        for (uint32_t bx = 0; bx < extent; bx += BrickMap::brickSize) {
+                            bool any = false;
+                            for (uint32_t o = 0; o < 8 && !any; o++) {
+                                any = source.brickAt(bx * 2 + (o & 1) * 8, by * 2 + ((o >> 1) & 1) * 8, bz * 2 + (o >> 2) * 8) != nullptr;
+                            }
+                            if (any) brickIndices.push_back(BrickMap::brickIndex(bx, by, bz));
+                        }
+                    }
+                }
+                if (brickIndices.empty()) return;
+                target.allocateBricks(brickIndices);
+                oom::misc::parallelFor(brickIndices.size(), threads, [&](size_t i) {
+                    const uint32_t index = brickIndices[i];
+                    const uint32_t bx = (index % BrickMap::gridSize) * 8, by = (index / BrickMap::gridSize % BrickMap::gridSize) * 8,
+                                   bz = (index / (BrickMap::gridSize * BrickMap::gridSize)) * 8;
+                    const BrickMap::Brick* below[8];
+                    for (uint32_t o = 0; o < 8; o++) below[o] = source.brickAt(bx * 2 + (o & 1) * 8, by * 2 + ((o >> 1) & 1) * 8, bz * 2 + (o >> 2) * 8);
+                    BrickMap::Brick& brick = target.brickFor(index);
+                    for (uint32_t c = 0; c < BrickMap::cellsPerBrick; c++) {
+                        // Source cell (2x + dx, 2y + dy, 2z + dz) lives in brick octant (x >> 2, y >> 2, z >> 2)
+                        const uint32_t x = c & 7, y = (c >> 3) & 7, z = c >> 6;
+                        const BrickMap::Brick* from = below[(x >> 2) | ((y >> 2) << 1) | ((z >> 2) << 2)];
+                        if (!from) continue;
+                        uint16_t votes[8];
+                        int count = 0;
+                        bool anyEmissive = false;
+                        for (uint32_t o = 0; o < 8; o++) {
+                            const BrickMap::Cell& cell = (*from)[BrickMap::cellIndex(static_cast<uint8_t>(x * 2 + (o & 1)),
+                                static_cast<uint8_t>(y * 2 + ((o >> 1) & 1)), static_cast<uint8_t>(z * 2 + (o >> 2)))];
+                            if (!cell.palette) continue;
+                            votes[count++] = static_cast<uint16_t>(cell.material * 256 + cell.palette);
+                            anyEmissive |= emissive[cell.material];
+                        }
+                        if (anyEmissive) {
+                            int kept = 0;
+                            for (int k = 0; k < count; k++) if (emissive[votes[k] >> 8]) votes[kept++] = votes[k];
+                            count = kept;
+                        }
+                        if (count == 0) continue;
+                        uint16_t winner = votes[0];
+                        int best = 0;
+                        for (int k = 0; k < count; k++) {
+                            int n = 0;
+                            for (int j = 0; j < count; j++) n += votes[j] == votes[k];
+                            if (n > best || (n == best && votes[k] < winner)) { best = n; winner = votes[k]; }
+                        }
+                        brick[c].material = static_cast<uint8_t>(winner >> 8);
+                        brick[c].palette = static_cast<uint8_t>(winner & 255);
+                    }
+                });
+                target.recount();
+            }
+
+            std::array<BrickMap, levelCount> levels;
+        };
+
+        // Counts kept up to date while voxels are added, so questions about a model are O(1)
+        // Buckets are indexed material * 256 + color. Chunks are the 512 32x32x32 chunks of model space by
+        // Morton index, same numbering as s.id.c
+        struct ModelStats {
+            uint64_t total = 0;
+            std::array<uint32_t, 8 * 256> bucketCounts{};
+            std::array<uint64_t, 8 * 256 / 64> usedMask{};     // bit b set when bucket b has voxels
+            std::array<uint32_t, 512> chunkCounts{};
+            uint8_t minx = 255, miny = 255, minz = 255;         // tight bounds, meaningless while total == 0
+            uint8_t maxx = 0, maxy = 0, maxz = 0;
+            uint64_t dsBytes = 0;                               // snapshot bytes decoded into the model
+
+            void add(uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                const uint32_t bucket = material * 256u + color;
+                total++;
+                bucketCounts[bucket]++;
+                usedMask[bucket >> 6] |= uint64_t(1) << (bucket & 63);
+                chunkCounts[encodeMorton3D(x >> 5, y >> 5, z >> 5)]++;
+                minx = std::min(minx, x); miny = std::min(miny, y); minz = std::min(minz, z);
+                maxx = std::max(maxx, x); maxy = std::max(maxy, y); maxz = std::max(maxz, z);
+            }
+
+            void merge(const ModelStats& other) {
+                total += other.total;
+                for (size_t b = 0; b < bucketCounts.size(); b++) bucketCounts[b] += other.bucketCounts[b];
+                for (size_t w = 0; w < usedMask.size(); w++) usedMask[w] |= other.usedMask[w];
+                for (size_t c = 0; c < chunkCounts.size(); c++) chunkCounts[c] += other.chunkCounts[c];
+                minx = std::min(minx, other.minx); miny = std::min(miny, other.miny); minz = std::min(minz, other.minz);
+                maxx = std::max(maxx, other.maxx); maxy = std::max(maxy, other.maxy); maxz = std::max(maxz, other.maxz);
+                dsBytes += other.dsBytes;
+            }
+
+            bool isUsed(int material, int color) const {
+                const uint32_t bucket = static_cast<uint32_t>(material * 256 + color);
+                return (usedMask[bucket >> 6] >> (bucket & 63)) & 1;
+            }
+            uint32_t count(int material, int color) const { return bucketCounts[material * 256 + color]; }
+            size_t usedBucketCount() const {
+                size_t used = 0;
+                for (uint64_t word : usedMask) used += popcount32(static_cast<uint32_t>(word)) + popcount32(static_cast<uint32_t>(word >> 32));
+                return used;
+            }
+
+            // For the job scheduler, only non empty buckets and chunks are listed
+            json toJson(uint64_t storageBytes = 0) const {
+                json out;
+                out["voxels"] = total;
+                out["dsBytes"] = dsBytes;
+                out["storageBytes"] = storageBytes;
+                if (total) {
+                    out["bounds"] = {{"min", {minx, miny, minz}}, {"max", {maxx, maxy, maxz}}};
+                }
+                json buckets = json::array();
+                for (uint32_t b = 0; b < bucketCounts.size(); b++) {
+                    if (bucketCounts[b]) buckets.push_back({{"material", b >> 8}, {"color", b & 255}, {"count", bucketCounts[b]}});
+                }
+                out["buckets"] = buckets;
+                static const char hex[] = "0123456789abcdef";
+                std::string mask;
+                for (uint64_t word : usedMask) {
+                    for (int nibble = 0; nibble < 16; nibble++) mask += hex[(word >> (nibble * 4)) & 15];  // bit 0 first
+                }
+                out["usedMask"] = mask;
+                json chunks = json::array();
+                for (uint32_t c = 0; c < chunkCounts.size(); c++) {
+                    if (chunkCounts[c]) chunks.push_back({{"id", c}, {"count", chunkCounts[c]}});
+                }
+                out["chunks"] = chunks;
+                return out;
+            }
+        };
+
+        // The [8][256] bucket table of a Model, voxels[m][c] indexes one pmr vector of 2048 buckets
+        // Every bucket allocates from the memory resource the table was built with
+        struct VoxelBucketTable {
+            std::pmr::vector<std::pmr::vector<Voxel>> buckets;
+
+            explicit VoxelBucketTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+                : buckets(8 * 256, resource) {}
+
+            std::pmr::vector<Voxel>* operator[](size_t material) { return buckets.data() + material * 256; }
+            const std::pmr::vector<Voxel>* operator[](size_t material) const { return buckets.data() + material * 256; }
+            std::pmr::memory_resource* resource() const { return buckets.get_allocator().resource(); }
+        };
+
+        // Monotonic arena for Models built in batch pipelines
+        // Bucket growth is a pointer bump, nothing is given back until the arena goes away, which frees
+        // the whole model in one go instead of thousands of deletes. Build the Model with resource()
+        // and destroy it before the arena. Reports what was taken from the heap against what is in use.
+        class ModelArena {
+        public:
+            explicit ModelArena(size_t initialBytes = size_t(16) << 20)
+                : heap(std::pmr::new_delete_resource()), arena(initialBytes, &heap), used(&arena) {}
+            ModelArena(const ModelArena&) = delete;
+            ModelArena& operator=(const ModelArena&) = delete;
+
+            std::pmr::memory_resource* resource() { return &used; }
+
+            size_t reservedBytes() const { return heap.allocatedBytes(); }   // taken from the heap by the arena
+            size_t usedBytes() const { return used.liveBytes(); }            // held by containers right now
+            size_t requestedBytes() const { return used.allocatedBytes(); }  // including buffers abandoned by growth
+
+            void print() const {
+                std::cout << "Model arena: " << reservedBytes() / 1024 << " KiB reserved, " << usedBytes() / 1024 << " KiB used, "
+                          << requestedBytes() / 1024 << " KiB requested" << std::endl;
+            }
+
+        private:
+            oom::misc::CountingResource heap;
+            std::pmr::monotonic_buffer_resource arena;
+            oom::misc::CountingResource used;
+        };
+
         // Create a structure to represent a model with its voxels with helper functions
         // since the xyz coords are at the voxel level, we need an accessor to walk it sequentially
         struct Model {
@@ -279,7 +1308,15 @@ namespace oom {
             // Voxels organized by material and color
             // First dimension: material (0-7)
             // Second dimension: color (1-255, index 0 unused since color 0 means no voxel)
-            std::vector<Voxel> voxels[8][256];
+            // Edit through insertVoxel where possible, after editing a bucket directly call recomputeStats()
+            // and invalidateSpatialIndex(), stats() is only maintained by insertVoxel and the loader
+            VoxelBucketTable voxels;
+
+            // Packed storage, see pack()
+            // All buckets back to back in one arena, bucket (m, c) is packedVoxels[packedOffsets[b], packedOffsets[b + 1])
+            // with b = m * 256 + c. packedOffsets is empty while the model uses voxels[8][256]
+            std::pmr::vector<PackedVoxel> packedVoxels;
+            std::pmr::vector<uint32_t> packedOffsets;
             
             // EDUCATIONAL NOTES ON DUAL DATA STRUCTURES FOR VOXELS:
             // ----------------------------------------------------
@@ -292,24 +1329,29 @@ namespace oom {
             //
             // 2. voxelsSpatial - Organizes voxels by their spatial position
             //    - Efficient for spatial queries like "what's at position (x,y,z)?"
-            //    - Uses a map for memory efficiency with sparse data
+            //    - Uses a brick map for memory efficiency with sparse data
+            //    - Built from the buckets on the first spatial query, dropped when voxels change
             //
             // Tradeoffs:
-            // - Memory: We use more memory by storing voxels twice
+            // - Memory: We use more memory by storing voxels twice, but only once someone asks
             // - Performance: We get optimal performance for both types of queries
-            // - Complexity: We need to maintain both structures in sync
+            // - Complexity: The index is derived data, it is rebuilt instead of kept in sync
             //
             // For novice programmers: This is a common technique in game/graphics programming
             // where performance is critical. We're trading some extra memory for faster access.
+            // Most conversions only walk the buckets and never pay for the second copy.
             
-            // Using a map for sparse 3D data instead of a fixed-size 3D array
-            // Key format: (x << 16) | (y << 8) | z
-            // This approach is memory-efficient for sparse data (mostly empty space)
+            // Using a brick map for sparse 3D data instead of a fixed-size 3D array
+            // Only 8x8x8 bricks that contain voxels are allocated, 2 bytes per cell
             // A 3D array would need 256³ = 16.7 million elements even if most are empty!
+            // Access it through spatialIndex()
+            mutable LazyIndex<BrickMap> voxelsSpatial;
 
+            // One bit per voxel for neighbor queries, access it through occupancy()
+            mutable LazyIndex<OccupancyGrid> voxelsOccupancy;
 
-            // todo we need to do morton decoing using chunkid to get x,y,z
-            std::map<uint32_t, std::vector<Voxel>> voxelsSpatial;
+            // 128^3, 64^3 and 32^3 previews, access it through lod()
+            mutable LazyIndex<ModelLod> voxelsLod;
             
             // Each model has local 0-7 materials
             std::array<Material, 8> materials;
@@ -317,20 +1359,33 @@ namespace oom {
             std::array<RGBA, 256> colors;
             uint8_t maxx=0, maxy=0, maxz=0;
 
+            // Filled as voxels are added, see stats()
+            ModelStats voxelStats;
+
+            // Keep every bucket in Morton (Z) order, see sortByMorton
+            // Loads sort each bucket once at the end, addVoxel inserts in place
+            bool keepMortonSorted = false;
+
             // Constructor
-            Model(const std::string& modelName) : vmaxbFileName(modelName) {
+            // @param resource: where voxel storage comes from, a ModelArena in batch pipelines. Must outlive the model
+            Model(const std::string& modelName, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+                : vmaxbFileName(modelName), voxels(resource), packedVoxels(resource), packedOffsets(resource) {
+            }
+
+            // Memory resource the voxel storage allocates from
+            std::pmr::memory_resource* resource() const {
+                return voxels.resource();
             }
             
-            // Helper function to create a key for the voxelsSpatial map
+            // Helper function to pack a position into a single key
             static uint32_t makeVoxelKey(uint8_t x, uint8_t y, uint8_t z) {
                 return (static_cast<uint32_t>(x) << 16) | (static_cast<uint32_t>(y) << 8) | static_cast<uint32_t>(z);
             }
             
             // Add a voxel to this model
             // EDUCATIONAL NOTE:
-            // Notice how we maintain BOTH data structures when adding a voxel.
-            // This is a key practice when using dual data structures - keep them in sync
-            // by updating both whenever data changes.
+            // Only the buckets are updated, the spatial index is invalidated and rebuilt
+            // in bulk the next time a spatial query needs it.
             void addVoxel(int x, int y, int z, int material, int color, int chunk, int chunkMin) {
 
                 //todo add chunk offset to x,y,z
@@ -339,53 +1394,136 @@ namespace oom {
                 decodeMorton3DOptimized(chunk, _tempx, _tempy, _tempz); // index IS the morton code
                 int worldOffsetX = _tempx * 24; // get world loc within 256x256x256 grid
                 int worldOffsetY = _tempy * 24; // Don't know why we need to multiply by 24
-                int worldOffsetZ = _tempz * 24; // use to be 32
+                int worldOffsetZ = _tempz * 24; // use to be 32, vmaxVoxelInfo already added chunk * 8
                 x += worldOffsetX;
                 y += worldOffsetY;
                 z += worldOffsetZ;
 
-
                 if (material >= 0 && material < 8 && color > 0 && color < 256) {
-                    voxels[material][color].emplace_back(x, y, z, material, color, chunk, chunkMin);
-                    
-                    // Add to voxelsSpatial using the map approach
-                    uint32_t key = makeVoxelKey(x, y, z);
-                    //todo add chunk offset to x,y,z
-                    voxelsSpatial[key].emplace_back(x, y, z, material, color, chunk, chunkMin);
-                    
-                    if (x > maxx) maxx = x;
-                    if (y > maxy) maxy = y;
-                    if (z > maxz) maxz = z;
+                    insertVoxel(static_cast<uint8_t>(x), static_cast<uint8_t>(y), static_cast<uint8_t>(z),
+                                static_cast<uint8_t>(material), static_cast<uint8_t>(color),
+                                static_cast<uint16_t>(chunk), static_cast<uint16_t>(chunkMin));
                 }
             }
-            
-            // Get voxels at a specific position
-            // EDUCATIONAL NOTE:
-            // This method demonstrates the power of our spatial index.
-            // Time complexity: O(log n) where n is the number of occupied positions.
-            // Without voxelsSpatial, we would need to scan through ALL voxels (potentially thousands)
+
+            /**
+            * Fused snapshot decode, straight from the ds bytes into this model's buckets
+            * Replaces vmaxVoxelInfo + the addVoxel loop: no copy of the ds data, no intermediate
+            * vectors, each voxel is Morton decoded once and lands at its final model coordinate.
+            * Produces exactly the voxels the two step path does, in the same order.
+            * 
+            * @param dsData material/color pairs of the snapshot, ie SnapshotView::ds
+            * @param chunkID s.id.c, Morton index of the 32x32x32 chunk in the 8x8x8 chunk grid
+            * @param minMorton s.st.min[3], Morton offset of the snapshot inside its chunk
+            */
+            void addSnapshot(ByteSpan dsData, uint64_t chunkID, uint64_t minMorton) {
+                // Chunk origin moves 32 voxels per chunk, the old 8 + 24
+                const uint16_t chunk = static_cast<uint16_t>(chunkID);
+                const uint16_t chunkMin = static_cast<uint16_t>(minMorton);
+                forEachSnapshotVoxel(dsData, chunkID, minMorton, [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                    insertVoxel(x, y, z, material, color, chunk, chunkMin);
+                });
+                voxelStats.dsBytes += dsData.size();
+            }
+
+            // Overload for snapshots read through BPlist
+            void addSnapshot(const SnapshotView& snapshot) {
+                if (snapshot.id < 0) return;
+                addSnapshot(snapshot.ds, static_cast<uint64_t>(snapshot.id), snapshot.mortoncode);
+            }
+
+            // Store a voxel at its final model coordinate, keeping both structures in sync
+            // On a packed model this unpacks the whole model first, O(n) and back to sizeof(Voxel) per voxel,
+            // see pack(). Models from loadWorld and ModelLoadOptions::packed are packed
+            void insertVoxel(uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color, uint16_t chunk, uint16_t chunkMin) {
+                if (isPacked()) unpack();
+                std::pmr::vector<Voxel>& bucket = voxels[material][color];
+                if (keepMortonSorted && !bucket.empty() && voxelMorton(bucket.back().x, bucket.back().y, bucket.back().z) > voxelMorton(x, y, z)) {
+                    const uint32_t morton = voxelMorton(x, y, z);
+                    auto at = std::upper_bound(bucket.begin(), bucket.end(), morton, [](uint32_t code, const Voxel& v) {
+                        return code < voxelMorton(v.x, v.y, v.z);
+                    });
+                    bucket.emplace(at, x, y, z, material, color, chunk, chunkMin);
+                } else {
+                    bucket.emplace_back(x, y, z, material, color, chunk, chunkMin);
+                }
+                voxelsSpatial.invalidate();
+                voxelsOccupancy.invalidate();
+                voxelsLod.invalidate();
+                voxelStats.add(x, y, z, material, color);
+
+                if (x > maxx) maxx = x;
+                if (y > maxy) maxy = y;
+                if (z > maxz) maxz = z;
+            }
+            
+            // Get voxels at a specific position
+            // EDUCATIONAL NOTE:
+            // This method demonstrates the power of our spatial index.
+            // Time complexity: O(1), two array lookups.
+            // Without voxelsSpatial, we would need to scan through ALL voxels (potentially thousands)
             // to find those at a specific position, which would be O(total_voxel_count).
-            const std::vector<Voxel>& getVoxelsAt(uint8_t x, uint8_t y, uint8_t z) const {
-                uint32_t key = makeVoxelKey(x, y, z);
-                auto it = voxelsSpatial.find(key);
-                if (it != voxelsSpatial.end()) {
-                    return it->second;
+            // The brick map only stores material and color, chunkID is rebuilt from the position
+            // and minMorton is 0 since the voxel is already at its final coordinate
+            VoxelsAt getVoxelsAt(uint8_t x, uint8_t y, uint8_t z) const {
+                VoxelsAt result;
+                BrickMap::Cell cell = spatialIndex().get(x, y, z);
+                if (cell.palette != 0) {
+                    uint16_t chunk = static_cast<uint16_t>(encodeMorton3D(x >> 5, y >> 5, z >> 5));
+                    result.voxel = Voxel(x, y, z, cell.material, cell.palette, chunk, 0);
+                    result.count = 1;
                 }
-                static const std::vector<Voxel> empty;
-                return empty;
+                return result;
             }
             
             // Check if there are voxels at a specific position
-            // Another spatial query that benefits from our map-based structure
+            // Another spatial query that benefits from our brick map
             bool hasVoxelsAt(uint8_t x, uint8_t y, uint8_t z) const {
-                uint32_t key = makeVoxelKey(x, y, z);
-                auto it = voxelsSpatial.find(key);
-                return (it != voxelsSpatial.end() && !it->second.empty());
+                return spatialIndex().has(x, y, z);
+            }
+
+            /**
+            * The spatial index, built on first use from the buckets
+            * Every voxel becomes a 64 bit key (position, bucket order, bucket) and the keys are sorted
+            * in parallel, which groups them by brick. Bricks are then allocated once and filled in
+            * parallel. When several voxels share a position the one that comes last in bucket order
+            * wins (material, then color, then insertion order), not the last one added.
+            * Safe to call from several threads, mutating the model while querying it is not.
+            */
+            const BrickMap& spatialIndex() const {
+                return voxelsSpatial.get([this](BrickMap& map) { buildSpatialIndex(map); });
+            }
+
+            /**
+            * Occupancy bitset of the whole model, built on first use from the buckets
+            * Use it for neighbor, face exposure and adjacency questions, see OccupancyGrid
+            */
+            const OccupancyGrid& occupancy() const {
+                return voxelsOccupancy.get([this](OccupancyGrid& grid) {
+                    grid.clear();
+                    forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t, uint8_t) { grid.set(x, y, z); });
+                });
+            }
+
+            /**
+            * Downsampled levels of the model for previews, built on first use from the spatial index
+            * A model edited after this rebuilds them on the next call, see ModelLod
+            */
+            const ModelLod& lod() const {
+                return voxelsLod.get([this](ModelLod& levels) { levels = ModelLod(spatialIndex(), materials); });
+            }
+
+            // Drop the spatial index, occupancy and LOD levels, call this after changing voxels[m][c] or packedVoxels directly
+            void invalidateSpatialIndex() {
+                voxelsSpatial.invalidate();
+                voxelsOccupancy.invalidate();
+                voxelsLod.invalidate();
             }
             
             // Add materials to this model
             void addMaterials(const std::array<Material, 8> newMaterials) {
                 materials = newMaterials;
+                voxelsLod.invalidate();     // emissive materials vote differently
             }
             
             // Add colors to this model
@@ -393,41 +1531,244 @@ namespace oom {
                 colors = newColors;
             }
             
-            // Get all voxels of a specific material and color
-            const std::vector<Voxel>& getVoxels(int material, int color) const {
-                if (material >= 0 && material < 8 && color > 0 && color < 256) {
-                    return voxels[material][color];
+            // Get all voxels of a specific material and color, packed or not
+            // A packed bucket yields Voxels expanded on the fly, see BucketVoxels
+            BucketVoxels getVoxels(int material, int color) const {
+                if (material < 0 || material >= 8 || color <= 0 || color >= 256) return {};
+                if (isPacked()) return BucketVoxels(getPackedVoxels(material, color), static_cast<uint8_t>(material), static_cast<uint8_t>(color));
+                return BucketVoxels(Span<const Voxel>(voxels[material][color].data(), voxels[material][color].size()));
+            }
+
+            // True when the voxels live in packedVoxels instead of voxels[8][256]
+            bool isPacked() const {
+                return !packedOffsets.empty();
+            }
+
+            /**
+            * Move every bucket into one contiguous arena of PackedVoxel
+            * 4 bytes per voxel instead of sizeof(Voxel), no per bucket allocations. chunkID and
+            * minMorton are dropped, nothing downstream reads them.
+            * Packing is for read-only models. insertVoxel, and so addVoxel/addSnapshot, calls unpack() first:
+            * the whole model goes back to sizeof(Voxel) per voxel in O(n) and the savings are gone until
+            * pack() is called again. Finish editing, then pack.
+            */
+            void pack() {
+                if (isPacked()) return;
+                packedOffsets.assign(8 * 256 + 1, 0);
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    packedOffsets[b + 1] = packedOffsets[b] + static_cast<uint32_t>(voxels[b >> 8][b & 255].size());
+                }
+                packedVoxels.clear();
+                packedVoxels.reserve(packedOffsets.back());
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    std::pmr::vector<Voxel>& bucket = voxels[b >> 8][b & 255];
+                    for (const Voxel& voxel : bucket) packedVoxels.push_back(packVoxel(voxel.x, voxel.y, voxel.z));
+                    bucket.clear();
+                    bucket.shrink_to_fit();
                 }
-                static std::vector<Voxel> empty;
-                return empty;
             }
-            
-            // Get total voxel count for this model
-            size_t getTotalVoxelCount() const {
-                size_t count = 0;
+
+            // Back to voxels[8][256], chunkID is rebuilt from the position and minMorton is 0
+            void unpack() {
+                if (!isPacked()) return;
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    std::pmr::vector<Voxel>& bucket = voxels[b >> 8][b & 255];
+                    bucket.reserve(bucket.size() + packedOffsets[b + 1] - packedOffsets[b]);
+                    for (uint32_t i = packedOffsets[b]; i < packedOffsets[b + 1]; i++) {
+                        bucket.push_back(unpackVoxel(packedVoxels[i], static_cast<uint8_t>(b >> 8), static_cast<uint8_t>(b & 255)));
+                    }
+                }
+                packedVoxels.clear();
+                packedVoxels.shrink_to_fit();
+                packedOffsets.clear();
+                packedOffsets.shrink_to_fit();
+            }
+
+            // Packed voxels of a specific material and color, empty unless isPacked()
+            Span<const PackedVoxel> getPackedVoxels(int material, int color) const {
+                if (!isPacked() || material < 0 || material >= 8 || color <= 0 || color >= 256) return {};
+                const uint32_t b = static_cast<uint32_t>(material * 256 + color);
+                return Span<const PackedVoxel>(packedVoxels.data() + packedOffsets[b], packedOffsets[b + 1] - packedOffsets[b]);
+            }
+
+            // Number of voxels in bucket b = material * 256 + color as stored, color 0 never holds voxels
+            size_t bucketSize(uint32_t b) const {
+                if ((b & 255) == 0) return 0;
+                return isPacked() ? packedOffsets[b + 1] - packedOffsets[b] : voxels[b >> 8][b & 255].size();
+            }
+
+            // Number of voxels in one material/color bucket, in either storage mode
+            // Read from storage so it stays exact after direct bucket edits
+            size_t getVoxelCount(int material, int color) const {
+                if (material < 0 || material >= 8 || color <= 0 || color >= 256) return 0;
+                return bucketSize(static_cast<uint32_t>(material * 256 + color));
+            }
+
+            // Counts, bounds and the used bucket mask, all O(1) to read
+            // Stale after editing voxels[m][c] or packedVoxels directly until recomputeStats() is called.
+            // getVoxelCount, getTotalVoxelCount and getUsedMaterialsAndColors read storage and never go stale
+            const ModelStats& stats() const {
+                return voxelStats;
+            }
+
+            // Bytes held by the voxel payload, from storage like getTotalVoxelCount
+            uint64_t storageBytes() const {
+                if (isPacked()) return packedVoxels.size() * sizeof(PackedVoxel) + packedOffsets.size() * sizeof(uint32_t);
+                return getTotalVoxelCount() * sizeof(Voxel);
+            }
+
+            // Stats as JSON for the job scheduler
+            json statsJson() const {
+                json out = voxelStats.toJson(storageBytes());
+                out["name"] = vmaxbFileName;
+                return out;
+            }
+
+            // Rebuild the stats from storage, call this after editing voxels[m][c] or packedVoxels directly
+            void recomputeStats() {
+                const uint64_t dsBytes = voxelStats.dsBytes;
+                voxelStats = ModelStats();
+                voxelStats.dsBytes = dsBytes;
+                forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                    voxelStats.add(x, y, z, material, color);
+                });
+            }
+
+            /**
+            * Visit every voxel bucket by bucket, in either storage mode
+            * @param visit called as visit(x, y, z, material, color)
+            */
+            template <typename Visit>
+            void forEachVoxel(Visit&& visit) const {
                 for (int m = 0; m < 8; m++) {
-                    for (int c = 1; c < 256; c++) {  // Skip index 0
-                        count += voxels[m][c].size();
+                    for (int c = 1; c < 256; c++) {
+                        if (isPacked()) {
+                            for (PackedVoxel v : getPackedVoxels(m, c)) visit(packedX(v), packedY(v), packedZ(v), static_cast<uint8_t>(m), static_cast<uint8_t>(c));
+                        } else {
+                            for (const Voxel& v : voxels[m][c]) visit(v.x, v.y, v.z, v.material, v.palette);
+                        }
                     }
                 }
-                return count;
+            }
+            
+            /**
+            * Sort every bucket into Morton (Z) order, in either storage mode
+            * Instancer arrays emitted from sorted buckets are spatially coherent, which is what a
+            * BVH builder and anything walking neighbors wants. Set keepMortonSorted to keep them so.
+            * @param threads 0 means one per hardware thread
+            */
+            void sortByMorton(unsigned threads = 0) {
+                oom::misc::parallelFor(8 * 256, threads, [&](size_t b) {
+                    if (isPacked()) {
+                        std::vector<uint64_t> keys;
+                        keys.reserve(packedOffsets[b + 1] - packedOffsets[b]);
+                        for (uint32_t i = packedOffsets[b]; i < packedOffsets[b + 1]; i++) {
+                            const PackedVoxel v = packedVoxels[i];
+                            keys.push_back((uint64_t(voxelMorton(packedX(v), packedY(v), packedZ(v))) << 32) | v);
+                        }
+                        radixSort24(keys, 32);
+                        for (size_t i = 0; i < keys.size(); i++) packedVoxels[packedOffsets[b] + i] = static_cast<PackedVoxel>(keys[i]);
+                    } else if (voxels[b >> 8][b & 255].size() > 1) {
+                        sortVoxelsByMorton(voxels[b >> 8][b & 255]);
+                    }
+                });
+            }
+
+            /**
+            * Visit every voxel of the model in global Morton (Z) order, across all buckets
+            * Built with one radix sort over 24 bit codes. Voxels sharing a position come in bucket order.
+            * @param visit called as visit(x, y, z, material, color)
+            */
+            template <typename Visit>
+            void forEachVoxelMortonOrder(Visit&& visit) const {
+                std::vector<uint64_t> keys;
+                keys.reserve(getTotalVoxelCount());
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    auto add = [&](uint8_t x, uint8_t y, uint8_t z) { keys.push_back((uint64_t(voxelMorton(x, y, z)) << 32) | b); };
+                    if (isPacked()) {
+                        for (PackedVoxel v : getPackedVoxels(static_cast<int>(b >> 8), static_cast<int>(b & 255))) add(packedX(v), packedY(v), packedZ(v));
+                    } else {
+                        for (const Voxel& v : voxels[b >> 8][b & 255]) add(v.x, v.y, v.z);
+                    }
+                }
+                radixSort24(keys, 32);
+                for (uint64_t key : keys) {
+                    const uint32_t position = decodeMorton3DPacked(static_cast<uint32_t>(key >> 32));
+                    const uint32_t bucket = static_cast<uint32_t>(key) & 2047;
+                    visit(static_cast<uint8_t>(position), static_cast<uint8_t>(position >> 8), static_cast<uint8_t>(position >> 16),
+                          static_cast<uint8_t>(bucket >> 8), static_cast<uint8_t>(bucket & 255));
+                }
+            }
+            
+            // Get total voxel count for this model
+            // Read from storage like getVoxelCount, one pass over the 2048 bucket sizes
+            size_t getTotalVoxelCount() const {
+                size_t total = 0;
+                for (uint32_t b = 0; b < 8 * 256; b++) total += bucketSize(b);
+                return total;
             }
             
             // Get a map of used materials and their associated colors
+            // Read from storage like getTotalVoxelCount, one pass over the 2048 bucket sizes
             std::map<int, std::set<int>> getUsedMaterialsAndColors() const {
                 std::map<int, std::set<int>> result;
-                
-                // Iterate through fixed size arrays - we know it's 8 materials and 256 colors
-                for (int material = 0; material < 8; material++) {
-                    for (int color = 1; color < 256; color++) {  // Skip index 0 as it means no voxel
-                        if (!voxels[material][color].empty()) {
-                            result[material].insert(color);
-                        }
-                    }
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    if (bucketSize(b)) result[b >> 8].insert(b & 255);  // bucketSize skips color 0, it means no voxel
                 }
-                
                 return result;
             }
+
+            // Bulk build for spatialIndex()
+            // key: brick index (15 bits) | cell index (9 bits) | global voxel order (29 bits) | bucket (11 bits)
+            void buildSpatialIndex(BrickMap& map) const {
+                map.clear();
+                std::vector<uint64_t> start(8 * 256 + 1, 0);
+                for (uint32_t b = 0; b < 8 * 256; b++) start[b + 1] = start[b] + bucketSize(b);   // storage, not stats, sizes keys
+                if (start.back() == 0) return;
+                if (start.back() >= (uint64_t(1) << 29)) {
+                    throw std::runtime_error("buildSpatialIndex: too many voxels");
+                }
+
+                std::vector<uint64_t> keys(start.back());
+                oom::misc::parallelFor(8 * 256, 0, [&](size_t b) {
+                    if ((b & 255) == 0) return;
+                    uint64_t order = start[b];
+                    auto emit = [&](uint8_t x, uint8_t y, uint8_t z) {
+                        const uint64_t position = (uint64_t(BrickMap::brickIndex(x, y, z)) << 9) | BrickMap::cellIndex(x, y, z);
+                        keys[order] = (position << 40) | (order << 11) | b;
+                        order++;
+                    };
+                    if (isPacked()) {
+                        for (PackedVoxel v : getPackedVoxels(static_cast<int>(b >> 8), static_cast<int>(b & 255))) emit(packedX(v), packedY(v), packedZ(v));
+                    } else {
+                        for (const Voxel& v : voxels[b >> 8][b & 255]) emit(v.x, v.y, v.z);
+                    }
+                });
+                oom::misc::parallelSort(keys, 0);
+
+                // Keys are grouped by brick now, one range per brick
+                std::vector<uint32_t> brickIndices;
+                std::vector<size_t> brickStart;
+                for (size_t i = 0; i < keys.size(); i++) {
+                    const uint32_t brick = static_cast<uint32_t>(keys[i] >> 49);
+                    if (brickIndices.empty() || brickIndices.back() != brick) {
+                        brickIndices.push_back(brick);
+                        brickStart.push_back(i);
+                    }
+                }
+                brickStart.push_back(keys.size());
+                map.allocateBricks(brickIndices);
+                oom::misc::parallelFor(brickIndices.size(), 0, [&](size_t i) {
+                    BrickMap::Brick& brick = map.brickFor(brickIndices[i]);
+                    for (size_t k = brickStart[i]; k < brickStart[i + 1]; k++) {
+                        const uint32_t bucket = static_cast<uint32_t>(keys[k] & 2047);
+                        BrickMap::Cell& cell = brick[(keys[k] >> 40) & 511];   // later keys overwrite earlier ones
+                        cell.material = static_cast<uint8_t>(bucket >> 8);
+                        cell.palette = static_cast<uint8_t>(bucket & 255);
+                    }
+                });
+                map.recount();
+            }
         };
 
         inline std::array<Material, 8> getMaterials(plist_t pnodPalettePlist) {
@@ -498,37 +1839,28 @@ namespace oom {
 
         /**
         * Decodes a voxel's material index and palette index from the ds data stream
+        * Most 32x32x32 chunks are mostly empty, so only occupied slots are Morton decoded,
+        * time is proportional to the voxel count rather than the chunk volume
         * 
         * @param dsData The raw ds data stream containing material and palette index pairs
         * @param mortonOffset offset to apply to the morton code
         * @param chunkID chunk ID
         * @return vector of Voxel structures containing the voxels local to a snapshot
         */
-        inline std::vector<Voxel> decodeVoxels(const std::vector<uint8_t>& dsData, int mortonOffset, uint16_t chunkID) {
+        inline std::vector<Voxel> decodeVoxels(ByteSpan dsData, int mortonOffset, uint16_t chunkID) {
             std::vector<Voxel> voxels;
-            uint8_t material;
-            uint8_t color;
-            for (int i = 0; i < dsData.size() - 1; i += 2) {
-                material = dsData[i]; // also known as a layer color
-                color = dsData[i + 1];
-                uint32_t _tempx, _tempy, _tempz;
-                decodeMorton3DOptimized(i/2 + mortonOffset,
-                                        _tempx,
-                                        _tempy,
-                                        _tempz); // index IS the morton code
-                if (color != 0) {
-                    Voxel voxel = {
-                        static_cast<uint8_t>(_tempx), 
-                        static_cast<uint8_t>(_tempy), 
-                        static_cast<uint8_t>(_tempz), 
-                        material,
-                        color,
-                        chunkID, // todo is wasteful to pass chunkID?
-                        static_cast<uint16_t>(mortonOffset)
-                    };
-                    voxels.push_back(voxel);
-                }
-            }
+            voxels.reserve(countOccupiedSlots(dsData));
+            forEachOccupiedSlot(dsData, [&](size_t slot, uint8_t material, uint8_t color) {
+                // also known as a layer color
+                uint32_t packed = decodeMorton3DPacked(static_cast<uint32_t>(slot + mortonOffset)); // index IS the morton code
+                voxels.emplace_back(static_cast<uint8_t>(packed),
+                                    static_cast<uint8_t>(packed >> 8),
+                                    static_cast<uint8_t>(packed >> 16),
+                                    material,
+                                    color,
+                                    chunkID, // todo is wasteful to pass chunkID?
+                                    static_cast<uint16_t>(mortonOffset));
+            });
             return voxels;
         }
 
@@ -609,45 +1941,12 @@ namespace oom {
             try {
 
                 // Extract the binary data
+                // libplist hands back a malloc'd copy, we own it and must free it
                 char* data = nullptr;
                 uint64_t length = 0;
                 plist_get_data_val(plist_datastream, &data, &length);
-                auto foo =  std::vector<uint8_t>(data, data + length) ;
-                std::vector<Voxel> allModelVoxels = decodeVoxels(std::vector<uint8_t>(data, data + length), minMorton, chunkID);
-
-                //std::cout << "allModelVoxels: " << allModelVoxels.size() << std::endl;
-
-                uint32_t model_8x8x8_x, model_8x8x8_y, model_8x8x8_z;
-                decodeMorton3DOptimized(chunkID, 
-                                        model_8x8x8_x, 
-                                        model_8x8x8_y, 
-                                        model_8x8x8_z); // index IS the morton code
-                int model_256x256x256_x = model_8x8x8_x * 8; // convert to model space
-                int model_256x256x256_y = model_8x8x8_y * 8;
-                int model_256x256x256_z = model_8x8x8_z * 8;
-
-                for (const Voxel& eachVmaxVoxel : allModelVoxels) {
-                    auto [  chunk_32x32x32_x, 
-                            chunk_32x32x32_y, 
-                            chunk_32x32x32_z, 
-                            materialMap, 
-                            colorMap, 
-                            chunkID, 
-                            minMorton] = eachVmaxVoxel;
-
-                    int voxel_256x256x256_x = model_256x256x256_x + chunk_32x32x32_x;
-                    int voxel_256x256x256_y = model_256x256x256_y + chunk_32x32x32_y;
-                    int voxel_256x256x256_z = model_256x256x256_z + chunk_32x32x32_z;
-
-                    auto one_voxel = Voxel(voxel_256x256x256_x, 
-                                           voxel_256x256x256_y, 
-                                           voxel_256x256x256_z, 
-                                           materialMap, 
-                                           colorMap,
-                                           chunkID,
-                                           minMorton);
-                    voxelsArray.push_back(one_voxel);
-                }
+                voxelsArray = vmaxVoxelInfo(ByteSpan(reinterpret_cast<const uint8_t*>(data), length), chunkID, minMorton);
+                free(data);
                 return voxelsArray;
             } catch (std::exception& e) {
                 std::cout << "Error: " << e.what() << std::endl;    
@@ -657,13 +1956,283 @@ namespace oom {
             return voxelsArray; // empty return
         }
 
+        // Same as above but decodes straight from a ds span, ie one handed out by BPlist
+        // @param datastream: raw ds bytes of a snapshot
+        // @return vector of Voxel
+        inline std::vector<Voxel> vmaxVoxelInfo(ByteSpan datastream, uint64_t chunkID, uint64_t minMorton) {
+            std::vector<Voxel> voxelsArray; 
+            voxelsArray.reserve(countOccupiedSlots(datastream));
+
+            // Chunk origin in 8x8 voxel units, Model::addVoxel adds the remaining * 24
+            const uint32_t chunkOrigin = decodeMorton3DPacked(static_cast<uint32_t>(chunkID) & 511) * 8; // 8x8x8 chunk grid
+            forEachOccupiedSlot(datastream, [&](size_t slot, uint8_t materialMap, uint8_t colorMap) {
+                uint32_t local = decodeMorton3DPacked(static_cast<uint32_t>(slot + minMorton)); // index IS the morton code
+                voxelsArray.emplace_back(static_cast<uint8_t>(local + chunkOrigin),
+                                         static_cast<uint8_t>((local >> 8) + (chunkOrigin >> 8)),
+                                         static_cast<uint8_t>((local >> 16) + (chunkOrigin >> 16)),
+                                         materialMap,
+                                         colorMap,
+                                         static_cast<uint16_t>(chunkID),
+                                         static_cast<uint16_t>(minMorton));
+            });
+            return voxelsArray;
+        }
+
+        // Zero-copy reader for Apple binary plists (bplist00)
+        // libplist's plist_from_memory builds a full DOM and plist_get_data_val copies every ds blob again,
+        // on large scenes that costs more than decoding the voxels. BPlist walks the offset table in place
+        // and hands out spans into the caller's buffer, there is no per-node allocation.
+        // The buffer must outlive the BPlist and every span taken from it.
+        //
+        // Layout reminder:
+        //   "bplist00" | objects ... | offset table | 32 byte trailer
+        //   trailer: 6 unused, offsetIntSize, objectRefSize, numObjects(8), topObject(8), offsetTableOffset(8) big endian
+        //   object marker byte: high nibble is the type, low nibble the size (0xF means an int object follows with the size)
+        class BPlist {
+        public:
+            using Ref = uint64_t;                  // object index into the offset table
+            static constexpr Ref npos = ~0ull;     // invalid / missing object
+
+            // Object types, high nibble of the marker byte
+            enum Kind : uint8_t {
+                kSimple = 0x0, // null, bool, fill
+                kInt    = 0x1,
+                kReal   = 0x2,
+                kDate   = 0x3,
+                kData   = 0x4,
+                kAscii  = 0x5,
+                kUtf16  = 0x6,
+                kUid    = 0x8,
+                kArray  = 0xA,
+                kSet    = 0xC,
+                kDict   = 0xD,
+                kInvalid = 0xFF
+            };
+
+            BPlist(const uint8_t* _data, size_t _size) : data(_data), size(_size) {
+                if (size < 8 + 32 || std::memcmp(data, "bplist00", 8) != 0) {
+                    throw std::runtime_error("Not a bplist00 buffer");
+                }
+                const uint8_t* trailer = data + size - 32;
+                offsetIntSize     = trailer[6];
+                objectRefSize     = trailer[7];
+                numObjects        = readBE(trailer + 8, 8);
+                topObject         = readBE(trailer + 16, 8);
+                offsetTableOffset = readBE(trailer + 24, 8);
+                if (offsetIntSize < 1 || offsetIntSize > 8 || objectRefSize < 1 || objectRefSize > 8 ||
+                    topObject >= numObjects || offsetTableOffset < 8 ||
+                    offsetTableOffset > size - 32 ||
+                    numObjects > (size - 32 - offsetTableOffset) / offsetIntSize) {
+                    throw std::runtime_error("Corrupt bplist00 trailer");
+                }
+            }
+
+            Ref root() const { return topObject; }
+
+            Kind kind(Ref ref) const {
+                const uint8_t* marker = object(ref);
+                return marker ? static_cast<Kind>(*marker >> 4) : kInvalid;
+            }
+
+            // Number of entries of an array/dict, or bytes of a data/ascii object
+            size_t count(Ref ref) const {
+                Kind k; uint64_t n; const uint8_t* payload;
+                return header(ref, k, n, payload) ? static_cast<size_t>(n) : 0;
+            }
+
+            // @return the ith element of an array or npos
+            Ref arrayItem(Ref ref, size_t i) const {
+                Kind k; uint64_t n; const uint8_t* payload;
+                if (!header(ref, k, n, payload) || k != kArray || i >= n) return npos;
+                return readRef(payload, i);
+            }
+
+            // @return the value stored under an ascii key or npos
+            Ref dictItem(Ref ref, const char* key) const {
+                Kind k; uint64_t n; const uint8_t* payload;
+                if (!header(ref, k, n, payload) || k != kDict) return npos;
+                size_t keyLength = std::strlen(key);
+                for (uint64_t i = 0; i < n; i++) {
+                    ByteSpan name = getAscii(readRef(payload, i));
+                    if (name.size() == keyLength && std::memcmp(name.data(), key, keyLength) == 0) {
+                        return readRef(payload, n + i); // values follow the n keys
+                    }
+                }
+                return npos;
+            }
+
+            // Walk nested dicts, the BPlist twin of getNestedPlistNode
+            Ref nested(Ref ref, std::initializer_list<const char*> path) const {
+                for (const char* key : path) {
+                    if (ref == npos) return npos;
+                    ref = dictItem(ref, key);
+                }
+                return ref;
+            }
+
+            // Integers are stored big endian in 1, 2, 4, 8 (signed) or 16 bytes
+            bool getUint(Ref ref, uint64_t& value) const {
+                const uint8_t* marker = object(ref);
+                if (!marker || (*marker >> 4) != kInt) return false;
+                size_t bytes = size_t(1) << (*marker & 0x0F);
+                if (bytes > 16 || !inBounds(marker + 1, bytes)) return false;
+                // 128 bit ints only carry a value in the low 8 bytes
+                value = bytes == 16 ? readBE(marker + 9, 8) : readBE(marker + 1, bytes);
+                return true;
+            }
+
+            // @return span over the bytes of a data object, empty if ref is not data
+            ByteSpan getData(Ref ref) const {
+                Kind k; uint64_t n; const uint8_t* payload;
+                if (!header(ref, k, n, payload) || k != kData || !inBounds(payload, n)) return {};
+                return ByteSpan(payload, static_cast<size_t>(n));
+            }
+
+            // @return span over the characters of an ascii string, empty otherwise
+            ByteSpan getAscii(Ref ref) const {
+                Kind k; uint64_t n; const uint8_t* payload;
+                if (!header(ref, k, n, payload) || k != kAscii || !inBounds(payload, n)) return {};
+                return ByteSpan(payload, static_cast<size_t>(n));
+            }
+
+        private:
+            const uint8_t* data;
+            size_t size;
+            uint8_t offsetIntSize = 0;
+            uint8_t objectRefSize = 0;
+            uint64_t numObjects = 0;
+            uint64_t topObject = 0;
+            uint64_t offsetTableOffset = 0;
+
+            static uint64_t readBE(const uint8_t* p, size_t bytes) {
+                uint64_t value = 0;
+                for (size_t i = 0; i < bytes; i++) {
+                    value = (value << 8) | p[i];
+                }
+                return value;
+            }
+
+            bool inBounds(const uint8_t* p, uint64_t bytes) const {
+                return p >= data && p <= data + size && bytes <= static_cast<uint64_t>(data + size - p);
+            }
+
+            // Object refs inside arrays/dicts are objectRefSize wide
+            Ref readRef(const uint8_t* refs, uint64_t i) const {
+                const uint8_t* p = refs + i * objectRefSize;
+                return inBounds(p, objectRefSize) ? readBE(p, objectRefSize) : npos;
+            }
+
+            // Resolve an object ref to its marker byte via the offset table
+            const uint8_t* object(Ref ref) const {
+                if (ref >= numObjects) return nullptr;
+                uint64_t offset = readBE(data + offsetTableOffset + ref * offsetIntSize, offsetIntSize);
+                if (offset < 8 || offset >= offsetTableOffset) return nullptr;
+                return data + offset;
+            }
+
+            // Decode marker + length of a variable sized object (data, strings, arrays, dicts)
+            bool header(Ref ref, Kind& k, uint64_t& n, const uint8_t*& payload) const {
+                const uint8_t* marker = object(ref);
+                if (!marker) return false;
+                k = static_cast<Kind>(*marker >> 4);
+                n = *marker & 0x0F;
+                payload = marker + 1;
+                if (n == 0x0F) { // length is stored in a following int object
+                    if (!inBounds(payload, 1) || (*payload >> 4) != kInt) return false;
+                    size_t bytes = size_t(1) << (*payload & 0x0F);
+                    if (bytes > 8 || !inBounds(payload + 1, bytes)) return false;
+                    n = readBE(payload + 1, bytes);
+                    payload += 1 + bytes;
+                }
+                uint64_t width = 1;
+                if (k == kUtf16) width = 2;
+                else if (k == kArray || k == kSet) width = objectRefSize;
+                else if (k == kDict) width = 2 * objectRefSize;
+                return n <= size && inBounds(payload, n * width);
+            }
+        };
+
+        // Collect the snapshots of a vmaxb without building a plist DOM
+        // @param bplist: reader over a decompressed contentsN.vmaxb
+        // @return one SnapshotView per entry of the root "snapshots" array, in file order
+        inline std::vector<SnapshotView> getSnapshots(const BPlist& bplist) {
+            std::vector<SnapshotView> snapshots;
+            BPlist::Ref snapshotsArray = bplist.dictItem(bplist.root(), "snapshots");
+            if (bplist.kind(snapshotsArray) != BPlist::kArray) {
+                std::cerr << "No snapshots array found in vmaxb" << std::endl;
+                return snapshots;
+            }
+            size_t snapshotCount = bplist.count(snapshotsArray);
+            snapshots.reserve(snapshotCount);
+            for (size_t i = 0; i < snapshotCount; i++) {
+                BPlist::Ref snapshot = bplist.dictItem(bplist.arrayItem(snapshotsArray, i), "s");
+                SnapshotView view{-1, 0, 0, {}};
+                uint64_t id = 0;
+                // vmax file format must guarantee the existence of s.st.min, s.id.t, s.id.c
+                if (bplist.getUint(bplist.arrayItem(bplist.nested(snapshot, {"st", "min"}), 3), view.mortoncode) &&
+                    bplist.getUint(bplist.nested(snapshot, {"id", "t"}), view.type) &&
+                    bplist.getUint(bplist.nested(snapshot, {"id", "c"}), id)) {
+                    view.id = static_cast<int64_t>(id);
+                    view.ds = bplist.getData(bplist.dictItem(snapshot, "ds"));
+                }
+                snapshots.push_back(view);
+            }
+            return snapshots;
+        }
+
+        // ChunkInfo for a snapshot read through BPlist
+        inline ChunkInfo vmaxChunkInfo(const SnapshotView& snapshot) {
+            if (snapshot.id < 0) return ChunkInfo{-1, 0, 0, 0, 0, 0};
+            uint32_t voxelOffsetX, voxelOffsetY, voxelOffsetZ;
+            decodeMorton3DOptimized(snapshot.mortoncode, voxelOffsetX, voxelOffsetY, voxelOffsetZ);
+            return ChunkInfo{snapshot.id, snapshot.type, snapshot.mortoncode, voxelOffsetX, voxelOffsetY, voxelOffsetZ};
+        }
+
+        /**
+        * Pick the snapshots that survive edit history
+        * A vmaxb keeps every snapshot ever written for a chunk, later ones replace earlier ones.
+        * Only the headers are read (through vmaxChunkInfo), no ds bytes are touched.
+        * 
+        * @param snapshots snapshots in file order
+        * @param skipped set to the number of usable snapshots that were superseded
+        * @return indices of the last snapshot per (chunk id, type), in file order
+        */
+        inline std::vector<size_t> latestSnapshots(const std::vector<SnapshotView>& snapshots, size_t& skipped) {
+            std::vector<bool> keep(snapshots.size(), false);
+            std::set<std::pair<int64_t, uint64_t>> seen;
+            skipped = 0;
+            for (size_t i = snapshots.size(); i-- > 0;) {
+                ChunkInfo info = vmaxChunkInfo(snapshots[i]);
+                if (info.id < 0) continue;
+                if (seen.emplace(info.id, info.type).second) keep[i] = true;
+                else skipped++;
+            }
+            std::vector<size_t> latest;
+            latest.reserve(seen.size());
+            for (size_t i = 0; i < snapshots.size(); i++) {
+                if (keep[i]) latest.push_back(i);
+            }
+            return latest;
+        }
+
+        // Bytes of a plist file, either the file mapping itself (uncompressed) or the lzfse decode output
+        // Keep it alive while a BPlist or any span from it is in use
+        struct PlistBuffer {
+            oom::misc::MappedFile mapping;   // uncompressed vmaxb, parsed in place
+            std::vector<uint8_t> decoded;    // lzfse compressed vmaxb, decoded here
+
+            const uint8_t* data() const { return mapping.is_open() ? mapping.data() : decoded.data(); }
+            size_t size() const { return mapping.is_open() ? mapping.size() : decoded.size(); }
+            bool empty() const { return size() == 0; }
+        };
+
         /**
         * Read a binary plist file and return a plist node.
         * if the file is lzfse compressed, decompress it and parse the decompressed data
         * 
         * Memory Management:
         * - Creates temporary buffers for decompression
-        * - Handles buffer resizing if needed
+        * - Sizes the decode buffer from the LZFSE block headers, only grows it if they can't be read
         * - Returns a plist node that must be freed by the caller
         * 
         * @param lzfseFullName Path to the LZFSE file
@@ -672,34 +2241,141 @@ namespace oom {
         */
         // read binary lzfse compressed/uncompressed file 
         inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist, bool decompress) {
-            // Get file size using std::filesystem
-            size_t rawFileSize = std::filesystem::file_size(inStrPlist);
-            std::vector<uint8_t> rawBytes(rawFileSize);
-            std::vector<uint8_t> outBuffer;
+            PlistBuffer outBuffer = readPlistBytes(inStrPlist, outStrPlist, decompress);
+            if (outBuffer.empty()) {
+                return nullptr;
+            }
+
+            // Parse the decompressed data as a plist
+            plist_t root_node = nullptr;
+            plist_format_t format;  // Will store the format of the plist (binary, xml, etc.)
+            
+            // Convert the raw decompressed data into a plist structure
+            plist_err_t err = plist_from_memory(
+                reinterpret_cast<const char*>(outBuffer.data()),  // Cast uint8_t* to char*
+                static_cast<uint32_t>(outBuffer.size()),          // Cast size_t to uint32_t
+                &root_node,                                       // Where to store the parsed plist
+                &format);                                         // Where to store the format
+            
+            // Check if parsing succeeded
+            if (err != PLIST_ERR_SUCCESS) {
+                std::cerr << "Failed to parse plist data" << std::endl;
+                return nullptr;
+            }
+            
+            return root_node;  // Caller is responsible for calling plist_free()
+        }
+
+        // Overload for when you only want to specify inStrPlist and decompress
+        inline plist_t readPlist(const std::string& inStrPlist, bool decompress) {
+            return readPlist(inStrPlist, "", decompress);
+        }
+
+        // Counters for readPlistBytes' lzfse decode, print them after a batch to see the passes saved
+        // by exact output sizing compared to the old grow-and-retry loop
+        struct LzfseDecodeStats {
+            std::atomic<uint64_t> files{0};         // lzfse files decoded
+            std::atomic<uint64_t> singlePass{0};    // decoded once into an exactly sized buffer
+            std::atomic<uint64_t> fallbacks{0};     // block scan failed, fell back to guessing
+            std::atomic<uint64_t> passesSaved{0};   // decode passes the rawFileSize * 8 guess would have needed on top
+
+            void print() const {
+                std::cout << "LZFSE files: " << files
+                          << " single pass: " << singlePass
+                          << " fallbacks: " << fallbacks
+                          << " passes saved: " << passesSaved << std::endl;
+            }
+        };
+        inline LzfseDecodeStats lzfseDecodeStats;
+
+        /**
+        * Walk the LZFSE block headers and sum the raw bytes each block decodes to.
+        * Only headers are read, nothing is decoded.
+        * 
+        * @param src compressed stream
+        * @param srcSize size of the compressed stream
+        * @param decodedSize receives the exact decoded size
+        * @return false if the stream has an unknown/truncated/malformed block, size must then be guessed
+        */
+        inline bool lzfseDecodedSize(const uint8_t* src, size_t srcSize, size_t& decodedSize) {
+            decodedSize = 0;
+            size_t pos = 0;
+            oom::misc::LzfseBlock block;
+            while (oom::misc::lzfseReadBlock(src + pos, srcSize - pos, block)) {
+                if (block.magic == oom::misc::LZFSE_ENDOFSTREAM_MAGIC) {
+                    return true;
+                }
+                if (block.blockBytes == 0) break; // no forward progress, corrupt header
+                decodedSize += block.rawBytes;
+                pos += block.blockBytes;
+            }
+            return false; // unknown block or ran out of bytes before bvx$
+        }
+
+        // Number of decode passes the old rawFileSize * 8 doubling guess takes for a given output size
+        inline uint64_t lzfseGuessPasses(size_t rawFileSize, size_t decodedSize) {
+            uint64_t passes = 1;
+            for (size_t guess = rawFileSize * 8; guess <= decodedSize && guess > 0; guess *= 2) {
+                passes++;
+            }
+            return passes;
+        }
+
+        /**
+        * Read a binary plist file and return its raw (decompressed) bytes.
+        * Wrap the result in a BPlist to read snapshots without building a libplist DOM
+        * 
+        * @param inStrPlist Path to the plist file, lzfse compressed or not
+        * @param outStrPlist Name of the plist file to write (optional)
+        * @param decompress true if the file is lzfse compressed
+        * @return decoded plist bytes, empty if decompression failed
+        */
+        inline PlistBuffer readPlistBytes(const std::string& inStrPlist, std::string outStrPlist, bool decompress) {
+            // Map the file instead of reading it, the lzfse decoder reads straight from the mapped pages
+            oom::misc::MappedFile rawBytes;
+            if (!rawBytes.open(inStrPlist)) {
+                std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
+                throw std::runtime_error("Error message"); // [learned] no need to return nullptr
+            }
+            size_t rawFileSize = rawBytes.size();
+            PlistBuffer plistBuffer;
+            std::vector<uint8_t>& outBuffer = plistBuffer.decoded;
             size_t decodedSize = 0;
             if (decompress) { // files are either lzfse compressed or uncompressed
-                std::ifstream rawBytesFile(inStrPlist, std::ios::binary);
-                if (!rawBytesFile.is_open()) {
-                    std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
-                    throw std::runtime_error("Error message"); // [learned] no need to return nullptr
-                }
-                
-                rawBytesFile.read(reinterpret_cast<char*>(rawBytes.data()), rawFileSize);
-                rawBytesFile.close();
-                // Start with output buffer 4x input size (compression ratio is usually < 4)
-                size_t outAllocatedSize = rawFileSize * 8;
-                // vector<uint8_t> automatically manages memory allocation/deallocation
-                //std::vector<uint8_t> outBuffer(outAllocatedSize);
-                outBuffer.resize(outAllocatedSize);  // Resize preserves existing content
 
                 // LZFSE needs a scratch buffer for its internal operations
                 // Get the required size and allocate it
                 size_t scratchSize = lzfse_decode_scratch_size();
                 std::vector<uint8_t> scratch(scratchSize);
+                lzfseDecodeStats.files++;
+
+                // Block headers carry the raw size of every block, sum them and decode once
+                size_t exactSize = 0;
+                if (lzfseDecodedSize(rawBytes.data(), rawBytes.size(), exactSize)) {
+                    // +1 so a full buffer can't be mistaken for a truncated decode
+                    outBuffer.resize(exactSize + 1);
+                    decodedSize = lzfse_decode_buffer(outBuffer.data(), outBuffer.size(),
+                                                      rawBytes.data(), rawBytes.size(),
+                                                      scratch.data());
+                    if (decodedSize == exactSize && exactSize > 0) {
+                        lzfseDecodeStats.singlePass++;
+                        lzfseDecodeStats.passesSaved += lzfseGuessPasses(rawFileSize, exactSize) - 1;
+                    } else {
+                        decodedSize = 0; // headers lied, use the growing buffer below
+                    }
+                }
+
+                // Fallback: guess the output size and grow it until the stream fits
+                // Start with output buffer 8x input size (compression ratio is usually < 8)
+                size_t outAllocatedSize = rawFileSize * 8;
+                if (decodedSize == 0) {
+                    lzfseDecodeStats.fallbacks++;
+                    // vector<uint8_t> automatically manages memory allocation/deallocation
+                    outBuffer.resize(outAllocatedSize);  // Resize preserves existing content
+                }
 
                 // Decompress the data, growing the output buffer if needed
-                //size_t decodedSize = 0;
-                while (true) {
+                while (decodedSize == 0) {
                     // Try to decompress with current buffer size
                     decodedSize = lzfse_decode_buffer(
                         outBuffer.data(),     // Where to store decompressed data
@@ -712,6 +2388,11 @@ namespace oom {
                     // - decodedSize == 0 indicates failure
                     // - decodedSize == outAllocatedSize might mean buffer was too small
                     if (decodedSize == 0 || decodedSize == outAllocatedSize) {
+                        if (outAllocatedSize == 0 || outAllocatedSize > rawFileSize * 4096) { // corrupt stream, not a small buffer
+                            decodedSize = 0;
+                            break;
+                        }
+                        decodedSize = 0;
                         outAllocatedSize *= 2;  // Double the buffer size
                         outBuffer.resize(outAllocatedSize);  // Resize preserves existing content
                         continue;  // Try again with larger buffer
@@ -722,7 +2403,7 @@ namespace oom {
                 // Check if decompression failed
                 if (decodedSize == 0) {
                     std::cerr << "Failed to decompress data" << std::endl;
-                    return nullptr;
+                    return {};
                 }
 
                 // If requested, write the decompressed data to a file
@@ -736,61 +2417,1285 @@ namespace oom {
                     }
                 }
             } else {
-                outBuffer.resize(rawFileSize); 
-                // if the file is not compressed, just read the raw bytes
-                std::ifstream rawBytesFile(inStrPlist, std::ios::binary);
-                if (!rawBytesFile.is_open()) {
-                    std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
-                    throw std::runtime_error("Error message"); // [learned] no need to return nullptr
-                }
-                rawBytesFile.read(reinterpret_cast<char*>(outBuffer.data()), rawFileSize);
-                rawBytesFile.close();
-                decodedSize = rawFileSize; // decodedSize is the same as rawFileSize when data is not compressed
-
-
+                // if the file is not compressed, parse straight from the mapping, no copy
+                plistBuffer.mapping = std::move(rawBytes);
+                return plistBuffer;
             } // outBuffer now contains the raw bytes of the plist file
 
-            // Parse the decompressed data as a plist
-            plist_t root_node = nullptr;
-            plist_format_t format;  // Will store the format of the plist (binary, xml, etc.)
-            
-            // Convert the raw decompressed data into a plist structure
-            plist_err_t err = plist_from_memory(
-                reinterpret_cast<const char*>(outBuffer.data()),  // Cast uint8_t* to char*
-                static_cast<uint32_t>(decodedSize),               // Cast size_t to uint32_t
-                &root_node,                                       // Where to store the parsed plist
-                &format);                                         // Where to store the format
-            
-            // Check if parsing succeeded
-            if (err != PLIST_ERR_SUCCESS) {
-                std::cerr << "Failed to parse plist data" << std::endl;
-                return nullptr;
-            }
-            
-            return root_node;  // Caller is responsible for calling plist_free()
+            outBuffer.resize(decodedSize); // drop the unused tail of the decode buffer
+            return plistBuffer;
         }
 
         // Overload for when you only want to specify inStrPlist and decompress
-        inline plist_t readPlist(const std::string& inStrPlist, bool decompress) {
-            return readPlist(inStrPlist, "", decompress);
+        inline PlistBuffer readPlistBytes(const std::string& inStrPlist, bool decompress) {
+            return readPlistBytes(inStrPlist, "", decompress);
         }
 
-        // Structure to hold object/model information from VoxelMax's scene.json
-        struct JsonModelInfo {
-            std::string id;
-            std::string parentId;
-            std::string name;
-            std::string dataFile;       // The .vmaxb file
-            std::string paletteFile;    // The palette PNG
-            std::string historyFile;    // The history file, not sure what this is
-            
-            // Transform information
-            std::vector<double> position;      // t_p
-            std::vector<double> rotation;      // t_r
-            std::vector<double> scale;         // t_s
-            
-            // Extent information
-            std::vector<double> extentCenter;  // e_c
+        // Options for loading vmaxb snapshots into a Model
+        struct ModelLoadOptions {
+            unsigned threads = 1;   // decode threads, 0 means one per hardware thread
+            bool latestSnapshotWins = true; // decode only the last snapshot per (chunk id, type), see latestSnapshots
+            std::optional<VoxelBox> roi;    // decode only voxels inside this box, snapshots outside it are never read
+            bool packed = false;            // merge straight into the packed arena, see Model::pack
+        };
+
+        // What a load did, for logs
+        struct ModelLoadReport {
+            size_t snapshots = 0;   // snapshots in the file
+            size_t decoded = 0;     // snapshots decoded into the model
+            size_t skipped = 0;     // snapshots superseded by a later one for the same chunk
+            size_t outsideRoi = 0;  // snapshots whose bounds miss the region of interest
+            unsigned threads = 1;   // decode threads actually used
+        };
+
+        // Per thread voxel buckets for the parallel loader
+        struct VoxelBuckets {
+            std::vector<Voxel> voxels[8][256];
+            ModelStats stats;
+            uint8_t maxx = 0, maxy = 0, maxz = 0;
+
+            void add(uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color, uint16_t chunk, uint16_t chunkMin) {
+                voxels[material][color].emplace_back(x, y, z, material, color, chunk, chunkMin);
+                stats.add(x, y, z, material, color);
+                if (x > maxx) maxx = x;
+                if (y > maxy) maxy = y;
+                if (z > maxz) maxz = z;
+            }
+        };
+
+        /**
+        * Decode snapshots into a model, optionally on several threads
+        * With threads > 1 the snapshots are split into contiguous runs of roughly equal ds bytes,
+        * each worker decodes its run into its own VoxelBuckets and the runs are appended to the model
+        * in file order. The result is identical to calling addSnapshot on each selected snapshot in order.
+        * With latestSnapshotWins (the default) superseded snapshots are dropped before decoding.
+        * 
+        * @param model model to decode into, existing voxels are kept
+        * @param snapshots snapshots from getSnapshots, the buffer they point into must be alive
+        * @param options see ModelLoadOptions
+        * @return counts of what was decoded
+        */
+        inline ModelLoadReport loadSnapshots(Model& model, const std::vector<SnapshotView>& snapshots, const ModelLoadOptions& options = {}) {
+            ModelLoadReport report;
+            report.snapshots = snapshots.size();
+
+            std::vector<const SnapshotView*> live;
+            if (options.latestSnapshotWins) {
+                std::vector<size_t> latest = latestSnapshots(snapshots, report.skipped);
+                live.reserve(latest.size());
+                for (size_t i : latest) live.push_back(&snapshots[i]);
+            } else {
+                live.reserve(snapshots.size());
+                for (const SnapshotView& snapshot : snapshots) {
+                    if (snapshot.id >= 0) live.push_back(&snapshot);
+                }
+            }
+            if (options.roi) {
+                // Header only test, ds bytes of rejected snapshots are never touched
+                size_t kept = 0;
+                for (const SnapshotView* snapshot : live) {
+                    VoxelBox bounds;
+                    if (snapshotBounds(snapshot->ds.size() / 2, static_cast<uint64_t>(snapshot->id), snapshot->mortoncode, bounds) &&
+                        bounds.intersects(*options.roi)) {
+                        live[kept++] = snapshot;
+                    } else {
+                        report.outsideRoi++;
+                    }
+                }
+                live.resize(kept);
+            }
+            report.decoded = live.size();
+            for (const SnapshotView* snapshot : live) model.voxelStats.dsBytes += snapshot->ds.size();
+
+            // Decode one snapshot into anything with an insertVoxel-like add(), clipping to the roi
+            auto decodeSnapshot = [&options](const SnapshotView& snapshot, auto&& add) {
+                const uint16_t chunk = static_cast<uint16_t>(snapshot.id);
+                const uint16_t chunkMin = static_cast<uint16_t>(snapshot.mortoncode);
+                const VoxelBox* roi = options.roi ? &*options.roi : nullptr;
+                forEachSnapshotVoxel(snapshot.ds, static_cast<uint64_t>(snapshot.id), snapshot.mortoncode,
+                    [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                        if (roi && !roi->contains(x, y, z)) return;
+                        add(x, y, z, material, color, chunk, chunkMin);
+                    });
+            };
+
+            unsigned threads = options.threads ? options.threads : oom::misc::defaultThreadCount();
+            threads = static_cast<unsigned>(std::min<size_t>(threads, live.size()));
+            threads = std::max(threads, 1u);
+            report.threads = threads;
+            if (threads == 1 && !options.packed && !model.keepMortonSorted) {
+                for (const SnapshotView* snapshot : live) {
+                    decodeSnapshot(*snapshot, [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color, uint16_t chunk, uint16_t chunkMin) {
+                        model.insertVoxel(x, y, z, material, color, chunk, chunkMin);
+                    });
+                }
+                return report;
+            }
+
+            // Contiguous runs of about equal ds bytes keep the merge order trivially deterministic
+            size_t totalBytes = 0;
+            for (const SnapshotView* snapshot : live) totalBytes += snapshot->ds.size();
+            std::vector<size_t> runStart(threads + 1, live.size());
+            runStart[0] = 0;
+            size_t bytes = 0;
+            unsigned run = 1;
+            for (size_t i = 0; i < live.size() && run < threads; i++) {
+                bytes += live[i]->ds.size();
+                if (bytes * threads >= totalBytes * run) runStart[run++] = i + 1;
+            }
+
+            std::vector<VoxelBuckets> workers(threads);
+            oom::misc::parallelFor(threads, threads, [&](size_t w) {
+                VoxelBuckets& buckets = workers[w];
+                for (size_t i = runStart[w]; i < runStart[w + 1]; i++) {
+                    decodeSnapshot(*live[i], [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color, uint16_t chunk, uint16_t chunkMin) {
+                        buckets.add(x, y, z, material, color, chunk, chunkMin);
+                    });
+                }
+            });
+
+            if (options.packed) {
+                // Size every bucket first, then each one is filled in place in the new arena
+                model.pack();
+                std::pmr::vector<uint32_t> offsets(8 * 256 + 1, 0, model.resource());
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    size_t count = model.packedOffsets[b + 1] - model.packedOffsets[b];
+                    for (const VoxelBuckets& worker : workers) count += worker.voxels[b >> 8][b & 255].size();
+                    offsets[b + 1] = offsets[b] + static_cast<uint32_t>(count);
+                }
+                std::pmr::vector<PackedVoxel> arena(offsets.back(), model.resource());
+                oom::misc::parallelFor(8 * 256, threads, [&](size_t bucket) {
+                    PackedVoxel* out = arena.data() + offsets[bucket];
+                    out = std::copy(model.packedVoxels.begin() + model.packedOffsets[bucket],
+                                    model.packedVoxels.begin() + model.packedOffsets[bucket + 1], out);
+                    for (const VoxelBuckets& worker : workers) {
+                        for (const Voxel& voxel : worker.voxels[bucket >> 8][bucket & 255]) *out++ = packVoxel(voxel.x, voxel.y, voxel.z);
+                    }
+                });
+                model.packedVoxels = std::move(arena);
+                model.packedOffsets = std::move(offsets);
+            } else {
+                model.unpack();
+                // Buckets are independent, append the runs in file order bucket by bucket
+                oom::misc::parallelFor(8 * 256, threads, [&](size_t bucket) {
+                    std::pmr::vector<Voxel>& merged = model.voxels[bucket >> 8][bucket & 255];
+                    size_t total = merged.size();
+                    for (const VoxelBuckets& worker : workers) total += worker.voxels[bucket >> 8][bucket & 255].size();
+                    if (total == merged.size()) return;
+                    merged.reserve(total);
+                    for (const VoxelBuckets& worker : workers) {
+                        const std::vector<Voxel>& part = worker.voxels[bucket >> 8][bucket & 255];
+                        merged.insert(merged.end(), part.begin(), part.end());
+                    }
+                });
+            }
+
+            if (model.keepMortonSorted) model.sortByMorton(threads);
+            model.invalidateSpatialIndex();
+            for (const VoxelBuckets& worker : workers) {
+                model.voxelStats.merge(worker.stats);
+                model.maxx = std::max(model.maxx, worker.maxx);
+                model.maxy = std::max(model.maxy, worker.maxy);
+                model.maxz = std::max(model.maxz, worker.maxz);
+            }
+            return report;
+        }
+
+        // Palette compressed 8x8x8 bricks, for keeping many decoded models resident
+        // Every brick stores a local palette of (material, color) pairs and one bit packed index per cell:
+        // 0 bits for a uniform brick, then 1, 2 or 4 bits for up to 2, 4 or 16 entries, 8 bits beyond that.
+        // Empty cells are palette entry 0 (color 0). Lookups read one word and one palette entry, no decoding.
+        class PaletteBrickGrid {
+        public:
+            static constexpr uint32_t gridSize = BrickMap::gridSize;
+
+            // Compress a model through its spatial index, one voxel per position like getVoxelsAt
+            explicit PaletteBrickGrid(const Model& model, unsigned threads = 0) {
+                build(model.spatialIndex(), threads);
+            }
+            explicit PaletteBrickGrid(const BrickMap& map, unsigned threads = 0) {
+                build(map, threads);
+            }
+
+            BrickMap::Cell get(uint8_t x, uint8_t y, uint8_t z) const {
+                uint16_t slot = top.empty() ? 0 : top[BrickMap::brickIndex(x, y, z)];
+                if (slot == 0) return BrickMap::Cell{};
+                const PaletteBrick& brick = bricks[slot - 1];
+                uint32_t index = 0;
+                if (brick.bits) {
+                    const uint32_t bit = BrickMap::cellIndex(x, y, z) * brick.bits;
+                    index = static_cast<uint32_t>(words[brick.wordOffset + (bit >> 6)] >> (bit & 63)) & ((1u << brick.bits) - 1);
+                }
+                const uint16_t value = palettes[brick.paletteOffset + index];
+                return BrickMap::Cell{static_cast<uint8_t>(value & 255), static_cast<uint8_t>(value >> 8)};
+            }
+
+            bool has(uint8_t x, uint8_t y, uint8_t z) const {
+                return get(x, y, z).palette != 0;
+            }
+
+            // visit(x, y, z, material, color) for every occupied cell, brick by brick
+            template <typename Visit>
+            void forEachVoxel(Visit&& visit) const {
+                if (top.empty()) return;
+                for (uint32_t b = 0; b < gridSize * gridSize * gridSize; b++) {
+                    if (!top[b]) continue;
+                    const uint32_t bx = (b % gridSize) * 8, by = (b / gridSize % gridSize) * 8, bz = (b / (gridSize * gridSize)) * 8;
+                    for (uint32_t cell = 0; cell < BrickMap::cellsPerBrick; cell++) {
+                        const uint8_t x = static_cast<uint8_t>(bx + (cell & 7)), y = static_cast<uint8_t>(by + ((cell >> 3) & 7)), z = static_cast<uint8_t>(bz + (cell >> 6));
+                        BrickMap::Cell value = get(x, y, z);
+                        if (value.palette) visit(x, y, z, value.material, value.palette);
+                    }
+                }
+            }
+
+            size_t brickCount() const { return bricks.size(); }
+            size_t uniformBrickCount() const {
+                size_t count = 0;
+                for (const PaletteBrick& brick : bricks) count += brick.bits == 0;
+                return count;
+            }
+            size_t memoryBytes() const {
+                return top.capacity() * sizeof(uint16_t) + bricks.capacity() * sizeof(PaletteBrick) +
+                       palettes.capacity() * sizeof(uint16_t) + words.capacity() * sizeof(uint64_t);
+            }
+
+        private:
+            struct PaletteBrick {
+                uint32_t wordOffset;    // first index word in `words`
+                uint32_t paletteOffset; // first entry in `palettes`
+                uint16_t paletteSize;
+                uint8_t bits;           // 0, 1, 2, 4 or 8 bits per cell
+            };
+
+            // One brick on its own, concatenated afterwards
+            struct EncodedBrick {
+                uint32_t brickIndex = 0;
+                uint8_t bits = 0;
+                std::vector<uint16_t> palette;
+                std::vector<uint64_t> words;
+            };
+
+            static uint8_t bitsFor(size_t paletteSize) {
+                if (paletteSize <= 1) return 0;
+                if (paletteSize <= 2) return 1;
+                if (paletteSize <= 4) return 2;
+                if (paletteSize <= 16) return 4;
+                return 8;
+            }
+
+            static void encode(const BrickMap::Brick& cells, EncodedBrick& out) {
+                uint16_t values[BrickMap::cellsPerBrick];
+                int16_t lookup[8 * 256];
+                std::fill(std::begin(lookup), std::end(lookup), int16_t(-1));
+                for (uint32_t cell = 0; cell < BrickMap::cellsPerBrick; cell++) {
+                    const uint16_t value = cells[cell].palette ? static_cast<uint16_t>((cells[cell].material << 8) | cells[cell].palette) : 0;
+                    values[cell] = value;
+                    if (lookup[value] < 0) {
+                        lookup[value] = static_cast<int16_t>(out.palette.size());
+                        out.palette.push_back(value);
+                    }
+                }
+                out.bits = bitsFor(out.palette.size());
+                if (out.bits == 0) return;
+                out.words.assign(BrickMap::cellsPerBrick * out.bits / 64, 0);
+                for (uint32_t cell = 0; cell < BrickMap::cellsPerBrick; cell++) {
+                    const uint32_t bit = cell * out.bits;
+                    out.words[bit >> 6] |= uint64_t(lookup[values[cell]]) << (bit & 63);
+                }
+            }
+
+            void build(const BrickMap& map, unsigned threads) {
+                std::vector<EncodedBrick> encoded;
+                for (uint32_t b = 0; b < gridSize * gridSize * gridSize; b++) {
+                    const uint8_t x = static_cast<uint8_t>((b % gridSize) * 8), y = static_cast<uint8_t>((b / gridSize % gridSize) * 8), z = static_cast<uint8_t>((b / (gridSize * gridSize)) * 8);
+                    if (map.brickAt(x, y, z)) {
+                        encoded.emplace_back();
+                        encoded.back().brickIndex = b;
+                    }
+                }
+                oom::misc::parallelFor(encoded.size(), threads, [&](size_t i) {
+                    const uint32_t b = encoded[i].brickIndex;
+                    encode(*map.brickAt(static_cast<uint8_t>((b % gridSize) * 8), static_cast<uint8_t>((b / gridSize % gridSize) * 8),
+                                        static_cast<uint8_t>((b / (gridSize * gridSize)) * 8)), encoded[i]);
+                });
+
+                size_t paletteTotal = 0, wordTotal = 0;
+                for (const EncodedBrick& brick : encoded) {
+                    paletteTotal += brick.palette.size();
+                    wordTotal += brick.words.size();
+                }
+                top.assign(gridSize * gridSize * gridSize, 0);
+                bricks.reserve(encoded.size());
+                palettes.reserve(paletteTotal);
+                words.reserve(wordTotal);
+                for (const EncodedBrick& brick : encoded) {
+                    if (brick.palette.size() == 1 && brick.palette[0] == 0) continue; // nothing in it
+                    bricks.push_back(PaletteBrick{static_cast<uint32_t>(words.size()), static_cast<uint32_t>(palettes.size()),
+                                                  static_cast<uint16_t>(brick.palette.size()), brick.bits});
+                    palettes.insert(palettes.end(), brick.palette.begin(), brick.palette.end());
+                    words.insert(words.end(), brick.words.begin(), brick.words.end());
+                    top[brick.brickIndex] = static_cast<uint16_t>(bricks.size());   // stored +1, 32768 bricks fit
+                }
+            }
+
+            std::vector<uint16_t> top;          // gridSize^3 brick indices + 1, 0 means empty
+            std::vector<PaletteBrick> bricks;
+            std::vector<uint16_t> palettes;     // material << 8 | color, 0 for empty
+            std::vector<uint64_t> words;        // bit packed palette indices
+        };
+
+        // A Model kept resident in compressed form: the palette bricks plus what is needed to render it
+        struct CompressedModel {
+            std::string vmaxbFileName;
+            std::array<Material, 8> materials;
+            std::array<RGBA, 256> colors;
+            PaletteBrickGrid grid;
+
+            explicit CompressedModel(const Model& model, unsigned threads = 0)
+                : vmaxbFileName(model.vmaxbFileName), materials(model.materials), colors(model.colors), grid(model, threads) {}
+
+            // Expand back into a regular Model, buckets come out in brick order
+            Model decompress(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+                Model model(vmaxbFileName, resource);
+                model.materials = materials;
+                model.colors = colors;
+                grid.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                    model.insertVoxel(x, y, z, material, color, static_cast<uint16_t>(encodeMorton3D(x >> 5, y >> 5, z >> 5)), 0);
+                });
+                return model;
+            }
+        };
+
+        // Pointer-less sparse voxel octree over the 256x256x256 model space
+        // Level 0 is the root, level 8 the voxels, a node at level L covers (256 >> L)^3 voxels. Nodes are
+        // stored breadth first, level after level, Morton order inside a level, and the children of a
+        // node sit next to each other starting at firstChild. Child octant bits are x | y << 1 | z << 2,
+        // the same as one step of a Morton code, so a node's Morton prefix is its path from the root.
+        class SparseVoxelOctree {
+        public:
+            static constexpr uint32_t depth = 8;
+
+            struct Node {
+                uint32_t firstChild = 0;    // index of the first child, 0 for voxels
+                uint32_t voxelCount = 0;    // occupied voxels below
+                uint8_t childMask = 0;      // bit o set when child octant o has voxels
+                uint8_t materialMask = 0;   // bit m set when material m occurs below
+                uint8_t material = 0;       // representative voxel below: the child with the most voxels, recursively
+                uint8_t color = 0;          // approximate mode, good enough to color a LOD cell
+            };
+            static_assert(sizeof(Node) == 12, "Node is serialized as is");
+
+            SparseVoxelOctree() = default;
+
+            // Build from a model, one voxel per position like getVoxelsAt
+            explicit SparseVoxelOctree(const Model& model, unsigned threads = 0) {
+                std::vector<uint32_t> codes;
+                std::vector<Node> leaves;
+                codes.reserve(model.getTotalVoxelCount());
+                leaves.reserve(model.getTotalVoxelCount());
+                model.forEachVoxelMortonOrder([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                    Node leaf;
+                    leaf.voxelCount = 1;
+                    leaf.materialMask = static_cast<uint8_t>(1u << material);
+                    leaf.material = material;
+                    leaf.color = color;
+                    const uint32_t code = voxelMorton(x, y, z);
+                    if (!codes.empty() && codes.back() == code) {
+                        leaves.back() = leaf;   // same position, the later bucket wins
+                        return;
+                    }
+                    codes.push_back(code);
+                    leaves.push_back(leaf);
+                });
+                build(std::move(codes), std::move(leaves), threads);
+            }
+
+            const std::vector<Node>& nodes() const { return nodeArray; }
+            // First node of a level, levelStart(depth + 1) is the node count
+            uint32_t levelStart(uint32_t level) const { return levelStarts[level]; }
+            bool empty() const { return nodeArray.empty(); }
+
+            /**
+            * Is the node at (x, y, z) of `level` empty, in O(level)
+            * @param level 0 (whole model) to 8 (single voxel)
+            * @param x y z node coordinates at that level, 0 to (1 << level) - 1
+            */
+            bool isRegionEmpty(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const {
+                return findNode(level, x, y, z) == npos;
+            }
+
+            // Is every voxel inside the box empty, descends only into nodes that overlap it
+            bool isRegionEmpty(const VoxelBox& box) const {
+                if (nodeArray.empty()) return true;
+                return regionEmpty(0, 0, 0, 0, 0, box);
+            }
+
+            // Node covering (x, y, z) at `level`, or npos
+            static constexpr uint32_t npos = 0xffffffffu;
+            uint32_t findNode(uint32_t level, uint32_t x, uint32_t y, uint32_t z) const {
+                if (nodeArray.empty() || level > depth) return npos;
+                uint32_t node = 0;
+                for (uint32_t l = 0; l < level; l++) {
+                    const uint32_t shift = level - 1 - l;
+                    const uint32_t octant = ((x >> shift) & 1) | (((y >> shift) & 1) << 1) | (((z >> shift) & 1) << 2);
+                    const uint8_t mask = nodeArray[node].childMask;
+                    if (!(mask & (1u << octant))) return npos;
+                    node = nodeArray[node].firstChild + popcount32(mask & ((1u << octant) - 1));
+                }
+                return node;
+            }
+
+            // Flat buffer: "OSVO", version, level starts, nodes, all little endian like the machines we run on
+            std::vector<uint8_t> serialize() const {
+                std::vector<uint8_t> out(headerBytes + nodeArray.size() * sizeof(Node));
+                std::memcpy(out.data(), "OSVO", 4);
+                const uint32_t version = 1;
+                std::memcpy(out.data() + 4, &version, 4);
+                std::memcpy(out.data() + 8, levelStarts.data(), levelStarts.size() * sizeof(uint32_t));
+                if (!nodeArray.empty()) std::memcpy(out.data() + headerBytes, nodeArray.data(), nodeArray.size() * sizeof(Node));
+                return out;
+            }
+
+            static SparseVoxelOctree deserialize(ByteSpan buffer) {
+                SparseVoxelOctree tree;
+                uint32_t version = 0;
+                if (buffer.size() < headerBytes || std::memcmp(buffer.data(), "OSVO", 4) != 0) {
+                    throw std::runtime_error("SparseVoxelOctree: not an octree buffer");
+                }
+                std::memcpy(&version, buffer.data() + 4, 4);
+                if (version != 1) throw std::runtime_error("SparseVoxelOctree: unsupported version");
+                std::memcpy(tree.levelStarts.data(), buffer.data() + 8, tree.levelStarts.size() * sizeof(uint32_t));
+                const size_t count = tree.levelStarts[depth + 1];
+                if (buffer.size() != headerBytes + count * sizeof(Node)) throw std::runtime_error("SparseVoxelOctree: truncated buffer");
+                // Levels must tile the node array in order, with a single root when there are nodes at all
+                if (tree.levelStarts[0] != 0 || (count && tree.levelStarts[1] != 1)) {
+                    throw std::runtime_error("SparseVoxelOctree: corrupt level starts");
+                }
+                for (uint32_t l = 0; l <= depth; l++) {
+                    if (tree.levelStarts[l] > tree.levelStarts[l + 1]) throw std::runtime_error("SparseVoxelOctree: corrupt level starts");
+                }
+                tree.nodeArray.resize(count);
+                if (count) std::memcpy(tree.nodeArray.data(), buffer.data() + headerBytes, count * sizeof(Node));
+                // findNode and regionEmpty follow firstChild without checks, every child range must lie in the next level
+                for (uint32_t l = 0; l < depth; l++) {
+                    for (uint32_t i = tree.levelStarts[l]; i < tree.levelStarts[l + 1]; i++) {
+                        const Node& node = tree.nodeArray[i];
+                        const uint64_t end = uint64_t(node.firstChild) + popcount32(node.childMask);
+                        if (node.childMask == 0 || node.firstChild < tree.levelStarts[l + 1] || end > tree.levelStarts[l + 2]) {
+                            throw std::runtime_error("SparseVoxelOctree: corrupt node " + std::to_string(i));
+                        }
+                    }
+                }
+                return tree;
+            }
+
+        private:
+            static constexpr size_t headerBytes = 8 + (depth + 2) * sizeof(uint32_t);
+
+            // Bottom up: each level's codes are the unique codes >> 3 of the level below. Levels are grouped
+            // in parallel slices cut on parent boundaries, then laid out root first.
+            void build(std::vector<uint32_t> codes, std::vector<Node> level, unsigned threads) {
+                levelStarts.fill(0);
+                if (codes.empty()) return;
+                std::vector<std::vector<Node>> levels(depth + 1);
+                std::vector<std::vector<uint32_t>> firstChildInLevel(depth + 1);   // index into the level below
+                levels[depth] = std::move(level);
+                for (uint32_t l = depth; l-- > 0;) {
+                    const std::vector<Node>& below = levels[l + 1];
+                    const size_t count = codes.size();
+                    const size_t slices = std::max<size_t>(1, std::min<size_t>(threads ? threads : oom::misc::defaultThreadCount(), count / 4096));
+                    std::vector<size_t> cut(slices + 1, count);
+                    cut[0] = 0;
+                    for (size_t i = 1; i < slices; i++) {
+                        size_t at = std::max(count * i / slices, cut[i - 1]);
+                        while (at < count && at > 0 && (codes[at] >> 3) == (codes[at - 1] >> 3)) at++;
+                        cut[i] = at;
+                    }
+                    std::vector<size_t> parentsIn(slices + 1, 0);
+                    oom::misc::parallelFor(slices, threads, [&](size_t s) {
+                        size_t parents = 0;
+                        for (size_t i = cut[s]; i < cut[s + 1]; i++) parents += i == cut[s] || (codes[i] >> 3) != (codes[i - 1] >> 3);
+                        parentsIn[s + 1] = parents;
+                    });
+                    for (size_t s = 0; s < slices; s++) parentsIn[s + 1] += parentsIn[s];
+                    std::vector<uint32_t> parentCodes(parentsIn[slices]);
+                    std::vector<Node> parents(parentsIn[slices]);
+                    std::vector<uint32_t> firstChild(parentsIn[slices]);
+                    oom::misc::parallelFor(slices, threads, [&](size_t s) {
+                        size_t p = parentsIn[s];
+                        for (size_t i = cut[s]; i < cut[s + 1];) {
+                            const uint32_t parentCode = codes[i] >> 3;
+                            Node node;
+                            uint32_t best = 0;
+                            firstChild[p] = static_cast<uint32_t>(i);
+                            for (; i < cut[s + 1] && (codes[i] >> 3) == parentCode; i++) {
+                                const Node& child = below[i];
+                                node.childMask |= static_cast<uint8_t>(1u << (codes[i] & 7));
+                                node.voxelCount += child.voxelCount;
+                                node.materialMask |= child.materialMask;
+                                if (child.voxelCount > best) {
+                                    best = child.voxelCount;
+                                    node.material = child.material;
+                                    node.color = child.color;
+                                }
+                            }
+                            parentCodes[p] = parentCode;
+                            parents[p++] = node;
+                        }
+                    });
+                    levels[l] = std::move(parents);
+                    firstChildInLevel[l] = std::move(firstChild);
+                    codes = std::move(parentCodes);
+                }
+
+                uint32_t total = 0;
+                for (uint32_t l = 0; l <= depth; l++) {
+                    levelStarts[l] = total;
+                    total += static_cast<uint32_t>(levels[l].size());
+                }
+                levelStarts[depth + 1] = total;
+                nodeArray.resize(total);
+                oom::misc::parallelFor(depth + 1, threads, [&](size_t l) {
+                    for (size_t i = 0; i < levels[l].size(); i++) {
+                        Node node = levels[l][i];
+                        if (l < depth) node.firstChild = levelStarts[l + 1] + firstChildInLevel[l][i];
+                        nodeArray[levelStarts[l] + i] = node;
+                    }
+                });
+            }
+
+            bool regionEmpty(uint32_t node, uint32_t level, uint32_t x, uint32_t y, uint32_t z, const VoxelBox& box) const {
+                const uint32_t size = 256u >> level;
+                if (x > box.maxx || y > box.maxy || z > box.maxz ||
+                    x + size - 1 < box.minx || y + size - 1 < box.miny || z + size - 1 < box.minz) return true;
+                if (level == depth) return false;
+                if (x >= box.minx && x + size - 1 <= box.maxx && y >= box.miny && y + size - 1 <= box.maxy &&
+                    z >= box.minz && z + size - 1 <= box.maxz) return false;   // fully inside and not empty
+                const Node& n = nodeArray[node];
+                uint32_t child = n.firstChild;
+                const uint32_t half = size / 2;
+                for (uint32_t octant = 0; octant < 8; octant++) {
+                    if (!(n.childMask & (1u << octant))) continue;
+                    if (!regionEmpty(child++, level + 1, x + (octant & 1) * half, y + ((octant >> 1) & 1) * half,
+                                     z + ((octant >> 2) & 1) * half, box)) return false;
+                }
+                return true;
+            }
+
+            std::vector<Node> nodeArray;
+            std::array<uint32_t, depth + 2> levelStarts{};
+        };
+
+        /**
+        * Read a vmaxb and decode all its snapshots into a model
+        * 
+        * @param model model to decode into
+        * @param vmaxbFullName path to contentsN.vmaxb
+        * @param decompress true if the file is lzfse compressed (the usual case)
+        * @param options see ModelLoadOptions
+        * @return counts of what was decoded
+        */
+        inline ModelLoadReport loadModel(Model& model, const std::string& vmaxbFullName, bool decompress, const ModelLoadOptions& options = {}) {
+            PlistBuffer plistBuffer = readPlistBytes(vmaxbFullName, decompress);
+            if (plistBuffer.empty()) {
+                std::cerr << "Error: Could not read vmaxb: " << vmaxbFullName << std::endl;
+                return {};
+            }
+            BPlist bplist(plistBuffer.data(), plistBuffer.size());
+            return loadSnapshots(model, getSnapshots(bplist), options);
+        }
+
+        // What a culling pass removed, for logs
+        struct CullReport {
+            size_t before = 0;      // voxel (box instance) count before culling
+            size_t after = 0;       // and after
+            unsigned threads = 1;
+        };
+
+        /**
+        * Drop opaque voxels that can never be seen, every voxel becomes a box instance in Bella and solid
+        * models are mostly interior. A voxel is hidden when its material is opaque and all six neighbors
+        * hold opaque voxels. Voxels next to a transmissive material (Material::transmission > 0), next to
+        * empty space or on the 0/255 model edge are kept. Bucket order is preserved.
+        * @param model culled in place, packed or not
+        * @param threads 0 for defaultThreadCount()
+        * @return instance counts before and after
+        */
+        inline CullReport cullHiddenVoxels(Model& model, unsigned threads = 0) {
+            CullReport report;
+            report.before = model.getTotalVoxelCount();
+            report.after = report.before;
+            if (report.before == 0) return report;
+            threads = threads ? threads : oom::misc::defaultThreadCount();
+            report.threads = threads;
+
+            bool opaque[8];
+            for (int m = 0; m < 8; m++) opaque[m] = !(model.materials[m].transmission > 0.0);
+
+            // Cells holding an opaque voxel and no transmissive one
+            OccupancyGrid solid;
+            model.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t) {
+                if (opaque[material]) solid.set(x, y, z);
+            });
+            model.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t) {
+                if (!opaque[material]) solid.reset(x, y, z);
+            });
+            if (solid.empty()) return report;
+
+            // Hidden cells, one task per row of 8 chunks along x since chunks along x share the 64 bit words
+            std::vector<uint64_t> hidden(size_t(256) * 256 * OccupancyGrid::wordsPerRow, 0);
+            oom::misc::parallelFor(8 * 8, threads, [&](size_t task) {
+                const uint32_t y0 = static_cast<uint32_t>(task % 8) * 32, z0 = static_cast<uint32_t>(task / 8) * 32;
+                uint64_t exposed[OccupancyGrid::wordsPerRow];
+                for (uint32_t z = z0; z < z0 + 32; z++) {
+                    for (uint32_t y = y0; y < y0 + 32; y++) {
+                        const uint64_t* row = solid.row(static_cast<uint8_t>(y), static_cast<uint8_t>(z));
+                        solid.exposedRowAny(static_cast<uint8_t>(y), static_cast<uint8_t>(z), exposed);
+                        uint64_t* out = &hidden[OccupancyGrid::wordIndex(static_cast<uint8_t>(y), static_cast<uint8_t>(z))];
+                        for (uint32_t i = 0; i < OccupancyGrid::wordsPerRow; i++) out[i] = row[i] & ~exposed[i];
+                    }
+                }
+            });
+            auto isHidden = [&hidden](uint8_t x, uint8_t y, uint8_t z) {
+                return (hidden[OccupancyGrid::wordIndex(y, z) + (x >> 6)] >> (x & 63)) & 1;
+            };
+
+            if (model.isPacked()) {
+                // Compact every bucket inside its own range first, then close the gaps in one pass
+                std::vector<uint32_t> kept(8 * 256, 0);
+                oom::misc::parallelFor(8 * 256, threads, [&](size_t bucket) {
+                    PackedVoxel* begin = model.packedVoxels.data() + model.packedOffsets[bucket];
+                    PackedVoxel* end = model.packedVoxels.data() + model.packedOffsets[bucket + 1];
+                    if (opaque[bucket >> 8]) {
+                        end = std::remove_if(begin, end, [&](PackedVoxel v) { return isHidden(packedX(v), packedY(v), packedZ(v)); });
+                    }
+                    kept[bucket] = static_cast<uint32_t>(end - begin);
+                });
+                uint32_t write = 0;
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    const uint32_t read = model.packedOffsets[b];
+                    if (read != write) std::copy(model.packedVoxels.begin() + read, model.packedVoxels.begin() + read + kept[b], model.packedVoxels.begin() + write);
+                    model.packedOffsets[b] = write;
+                    write += kept[b];
+                }
+                model.packedOffsets[8 * 256] = write;
+                model.packedVoxels.resize(write);
+            } else {
+                oom::misc::parallelFor(8 * 256, threads, [&](size_t bucket) {
+                    if (!opaque[bucket >> 8]) return;
+                    std::pmr::vector<Voxel>& voxels = model.voxels[bucket >> 8][bucket & 255];
+                    voxels.erase(std::remove_if(voxels.begin(), voxels.end(),
+                        [&](const Voxel& v) { return isHidden(v.x, v.y, v.z); }), voxels.end());
+                });
+            }
+
+            model.invalidateSpatialIndex();
+            model.recomputeStats();
+            report.after = model.getTotalVoxelCount();
+            return report;
+        }
+
+        // Greedy mesh of a Model, coplanar faces of the same (material, color) merged into quads
+        // Every 32x32x32 chunk is meshed on its own, in parallel, and the chunks are appended in Morton
+        // order so the buffers are identical for any thread count. Faces are decided against the whole
+        // model, so nothing is emitted between two chunks. A face is emitted when the neighbor cell is
+        // empty, or when the two cells differ and one of them is transmissive. Where buckets overlap the
+        // later one wins, as in Model::spatialIndex.
+        class VoxelMesh {
+        public:
+            // 8 bytes, corners of the voxel lattice so coordinates run 0..256
+            struct Vertex {
+                uint16_t x, y, z;
+                uint8_t normal;     // OccupancyGrid::Face
+                uint8_t pad = 0;
+            };
+            // Index/vertex buffers of one (material, color), two triangles per quad, counter clockwise seen from outside
+            struct Part {
+                uint8_t material = 0;
+                uint8_t color = 0;
+                std::vector<Vertex> vertices;
+                std::vector<uint32_t> indices;
+            };
+
+            VoxelMesh() = default;
+            explicit VoxelMesh(const Model& model, unsigned threads = 0) {
+                build(model, threads ? threads : oom::misc::defaultThreadCount());
+            }
+
+            // Non empty parts by material then color
+            const std::vector<Part>& parts() const { return meshParts; }
+            size_t quadCount() const { return quads; }
+            size_t vertexCount() const { return quads * 4; }
+            size_t memoryBytes() const {
+                size_t total = 0;
+                for (const Part& part : meshParts) total += part.vertices.capacity() * sizeof(Vertex) + part.indices.capacity() * sizeof(uint32_t);
+                return total;
+            }
+
+        private:
+            static constexpr int chunkSize = 32;
+            static constexpr int paddedSize = chunkSize + 2;
+
+            struct Quad {
+                uint16_t bucket;            // material * 256 + color
+                uint8_t face;
+                uint8_t plane;              // slice inside the chunk along the face axis
+                uint8_t u, v, w, h;         // start and extent inside the chunk along the two other axes
+            };
+
+            // Bucket + 1 of every cell of the chunk and a one cell border, 0 when empty
+            static void fillPadded(const BrickMap& cells, int cx, int cy, int cz, std::vector<uint16_t>& grid) {
+                std::fill(grid.begin(), grid.end(), 0);
+                auto at = [&grid](int x, int y, int z) -> uint16_t& {
+                    return grid[(static_cast<size_t>(z + 1) * paddedSize + (y + 1)) * paddedSize + (x + 1)];
+                };
+                auto cellValue = [](const BrickMap::Cell& cell) -> uint16_t {
+                    return cell.palette ? static_cast<uint16_t>(cell.material * 256 + cell.palette + 1) : 0;
+                };
+                const int x0 = cx * chunkSize, y0 = cy * chunkSize, z0 = cz * chunkSize;
+                for (int bz = 0; bz < chunkSize; bz += BrickMap::brickSize) {
+                    for (int by = 0; by < chunkSize; by += BrickMap::brickSize) {
+                        for (int bx = 0; bx < chunkSize; bx += BrickMap::brickSize) {
+                            const BrickMap::Brick* brick = cells.brickAt(x0 + bx, y0 + by, z0 + bz);
+                            if (!brick) continue;
+                            for (int z = bz; z < bz + int(BrickMap::brickSize); z++) {
+                                for (int y = by; y < by + int(BrickMap::brickSize); y++) {
+                                    for (int x = bx; x < bx + int(BrickMap::brickSize); x++) {
+                                        at(x, y, z) = cellValue((*brick)[BrickMap::cellIndex(x0 + x, y0 + y, z0 + z)]);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                // The border comes from the neighbor chunks, outside the model stays empty
+                auto border = [&](int x, int y, int z) {
+                    const int wx = x0 + x, wy = y0 + y, wz = z0 + z;
+                    if (wx < 0 || wx > 255 || wy < 0 || wy > 255 || wz < 0 || wz > 255) return;
+                    at(x, y, z) = cellValue(cells.get(static_cast<uint8_t>(wx), static_cast<uint8_t>(wy), static_cast<uint8_t>(wz)));
+                };
+                for (int a = 0; a < chunkSize; a++) {
+                    for (int b = 0; b < chunkSize; b++) {
+                        border(-1, a, b); border(chunkSize, a, b);
+                        border(a, -1, b); border(a, chunkSize, b);
+                        border(a, b, -1); border(a, b, chunkSize);
+                    }
+                }
+            }
+
+            static void meshChunk(const std::vector<uint16_t>& grid, const bool transmissive[8], std::vector<Quad>& out) {
+                static const int stride[3] = {1, paddedSize, paddedSize * paddedSize};
+                const int interior = stride[0] + stride[1] + stride[2];
+                auto visible = [&transmissive](uint16_t self, uint16_t neighbor) {
+                    if (!self) return false;
+                    if (!neighbor) return true;
+                    return self != neighbor && (transmissive[(self - 1) >> 8] || transmissive[(neighbor - 1) >> 8]);
+                };
+                uint16_t mask[chunkSize * chunkSize];
+                for (int face = OccupancyGrid::NegX; face <= OccupancyGrid::PosZ; face++) {
+                    const int axis = face / 2, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+                    const int neighbor = (face & 1) ? stride[axis] : -stride[axis];
+                    for (int d = 0; d < chunkSize; d++) {
+                        // Bucket + 1 of every visible face in this slice
+                        for (int v = 0; v < chunkSize; v++) {
+                            const uint16_t* line = grid.data() + interior + d * stride[axis] + v * stride[vAxis];
+                            for (int u = 0; u < chunkSize; u++) {
+                                const uint16_t self = line[u * stride[uAxis]];
+                                mask[v * chunkSize + u] = visible(self, line[u * stride[uAxis] + neighbor]) ? self : 0;
+                            }
+                        }
+                        // Grow each rectangle along u, then along v while the whole row matches
+                        for (int v = 0; v < chunkSize; v++) {
+                            for (int u = 0; u < chunkSize; ) {
+                                const uint16_t id = mask[v * chunkSize + u];
+                                if (!id) { u++; continue; }
+                                int w = 1;
+                                while (u + w < chunkSize && mask[v * chunkSize + u + w] == id) w++;
+                                int h = 1;
+                                for (; v + h < chunkSize; h++) {
+                                    bool rowMatches = true;
+                                    for (int k = 0; k < w && rowMatches; k++) rowMatches = mask[(v + h) * chunkSize + u + k] == id;
+                                    if (!rowMatches) break;
+                                }
+                                for (int j = 0; j < h; j++) std::fill_n(&mask[(v + j) * chunkSize + u], w, uint16_t(0));
+                                out.push_back(Quad{static_cast<uint16_t>(id - 1), static_cast<uint8_t>(face), static_cast<uint8_t>(d),
+                                                   static_cast<uint8_t>(u), static_cast<uint8_t>(v), static_cast<uint8_t>(w), static_cast<uint8_t>(h)});
+                                u += w;
+                            }
+                        }
+                    }
+                }
+            }
+
+            void build(const Model& model, unsigned threads) {
+                const BrickMap& cells = model.spatialIndex();
+                bool transmissive[8];
+                for (int m = 0; m < 8; m++) transmissive[m] = model.materials[m].transmission > 0.0;
+
+                // Chunk numbering follows s.id.c. A chunk is 4x4x4 bricks, skip it when none of them is allocated,
+                // the same index the geometry comes from so it can't disagree with it
+                std::vector<std::vector<Quad>> chunkQuads(512);
+                std::vector<uint32_t> chunks;
+                for (uint32_t c = 0; c < 512; c++) {
+                    uint32_t cx, cy, cz;
+                    decodeMorton3DOptimized(c, cx, cy, cz);
+                    bool occupied = false;
+                    for (uint32_t b = 0; b < 64 && !occupied; b++) {
+                        occupied = cells.brickAt(static_cast<uint8_t>(cx * chunkSize + (b & 3) * BrickMap::brickSize),
+                                                 static_cast<uint8_t>(cy * chunkSize + ((b >> 2) & 3) * BrickMap::brickSize),
+                                                 static_cast<uint8_t>(cz * chunkSize + (b >> 4) * BrickMap::brickSize)) != nullptr;
+                    }
+                    if (occupied) chunks.push_back(c);
+                }
+                oom::misc::parallelFor(chunks.size(), threads, [&](size_t i) {
+                    thread_local std::vector<uint16_t> grid;
+                    grid.resize(size_t(paddedSize) * paddedSize * paddedSize);
+                    uint32_t cx, cy, cz;
+                    decodeMorton3DOptimized(chunks[i], cx, cy, cz);
+                    fillPadded(cells, cx, cy, cz, grid);
+                    meshChunk(grid, transmissive, chunkQuads[chunks[i]]);
+                });
+
+                // Deterministic merge, chunk after chunk in Morton order into the part of each bucket
+                std::vector<uint32_t> bucketQuads(8 * 256, 0);
+                for (const std::vector<Quad>& list : chunkQuads) {
+                    for (const Quad& quad : list) bucketQuads[quad.bucket]++;
+                }
+                std::vector<int> partOf(8 * 256, -1);
+                for (uint32_t b = 0; b < 8 * 256; b++) {
+                    if (!bucketQuads[b]) continue;
+                    partOf[b] = static_cast<int>(meshParts.size());
+                    meshParts.emplace_back();
+                    Part& part = meshParts.back();
+                    part.material = static_cast<uint8_t>(b >> 8);
+                    part.color = static_cast<uint8_t>(b & 255);
+                    part.vertices.reserve(size_t(bucketQuads[b]) * 4);
+                    part.indices.reserve(size_t(bucketQuads[b]) * 6);
+                    quads += bucketQuads[b];
+                }
+                for (uint32_t c = 0; c < 512; c++) {
+                    if (chunkQuads[c].empty()) continue;
+                    uint32_t cx, cy, cz;
+                    decodeMorton3DOptimized(c, cx, cy, cz);
+                    const int origin[3] = {int(cx) * chunkSize, int(cy) * chunkSize, int(cz) * chunkSize};
+                    for (const Quad& quad : chunkQuads[c]) appendQuad(meshParts[partOf[quad.bucket]], quad, origin);
+                }
+            }
+
+            // Corners go counter clockwise around +axis since u x v = axis, negative faces flip the winding
+            static void appendQuad(Part& part, const Quad& quad, const int origin[3]) {
+                const int axis = quad.face / 2, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+                const bool positive = quad.face & 1;
+                const uint32_t base = static_cast<uint32_t>(part.vertices.size());
+                const int du[4] = {0, quad.w, quad.w, 0};
+                const int dv[4] = {0, 0, quad.h, quad.h};
+                for (int corner = 0; corner < 4; corner++) {
+                    int p[3];
+                    p[axis] = origin[axis] + quad.plane + (positive ? 1 : 0);
+                    p[uAxis] = origin[uAxis] + quad.u + du[corner];
+                    p[vAxis] = origin[vAxis] + quad.v + dv[corner];
+                    part.vertices.push_back(Vertex{static_cast<uint16_t>(p[0]), static_cast<uint16_t>(p[1]), static_cast<uint16_t>(p[2]), quad.face});
+                }
+                static const uint32_t front[6] = {0, 1, 2, 0, 2, 3};
+                static const uint32_t back[6] = {0, 2, 1, 0, 3, 2};
+                const uint32_t* order = positive ? front : back;
+                for (int i = 0; i < 6; i++) part.indices.push_back(base + order[i]);
+            }
+
+            std::vector<Part> meshParts;
+            size_t quads = 0;
+        };
+
+        // Islands of a model: groups of face connected voxels (6-connectivity), deduplicated by shape and colors
+        // Repeated props inside one model become one prototype plus one instance per copy
+        struct IslandVoxel {
+            uint8_t x, y, z;        // relative to the island's minimum corner
+            uint8_t material, color;
+        };
+        struct IslandPrototype {
+            uint64_t hash = 0;      // of the sorted voxels, positions and colors
+            uint8_t sizex = 0, sizey = 0, sizez = 0;   // bounds extent minus one
+            std::vector<IslandVoxel> voxels;           // sorted by z, then y, then x
+        };
+        struct IslandInstance {
+            uint32_t prototype;
+            uint8_t x, y, z;        // model space position of the prototype's minimum corner
+        };
+        struct ModelIslands {
+            std::vector<IslandPrototype> prototypes;
+            std::vector<IslandInstance> instances;     // in order of the first voxel of each island, chunk by chunk
+            size_t voxelCount = 0;                     // occupied cells of the model
+            size_t prototypeVoxelCount() const {
+                size_t total = 0;
+                for (const IslandPrototype& prototype : prototypes) total += prototype.voxels.size();
+                return total;
+            }
+        };
+
+        /**
+        * Split a model into islands and instance identical ones
+        * Union find over the occupancy: every 32x32x32 chunk is labeled in parallel on its own, then the few
+        * unions across chunk faces are done in one serial pass. Islands are hashed in parallel and equal hashes
+        * are compared voxel by voxel before two islands share a prototype, so a collision can't merge shapes.
+        * Colors come from the spatial index, where buckets overlap the later one wins.
+        * @param threads 0 for defaultThreadCount()
+        */
+        inline ModelIslands findIslands(const Model& model, unsigned threads = 0) {
+            threads = threads ? threads : oom::misc::defaultThreadCount();
+            ModelIslands result;
+            const OccupancyGrid& occupied = model.occupancy();
+            const BrickMap& cells = model.spatialIndex();
+            if (occupied.empty()) return result;
+
+            // Voxels are numbered chunk by chunk, row by row inside a chunk, the index of any occupied cell is
+            // its chunk's base + its row's start + the set bits before it in the row
+            auto chunkBits = [&occupied](uint32_t chunk, uint32_t y, uint32_t z) {
+                uint32_t cx, cy, cz;
+                decodeMorton3DOptimized(chunk, cx, cy, cz);
+                const uint64_t* row = occupied.row(static_cast<uint8_t>(cy * 32 + y), static_cast<uint8_t>(cz * 32 + z));
+                return static_cast<uint32_t>(row[cx >> 1] >> ((cx & 1) * 32));
+            };
+            std::vector<uint32_t> rowStart(512 * 32 * 32);
+            std::vector<uint32_t> chunkBase(512 + 1, 0);
+            oom::misc::parallelFor(512, threads, [&](size_t chunk) {
+                uint32_t count = 0;
+                for (uint32_t r = 0; r < 32 * 32; r++) {
+                    rowStart[chunk * 1024 + r] = count;
+                    count += popcount32(chunkBits(static_cast<uint32_t>(chunk), r & 31, r >> 5));
+                }
+                chunkBase[chunk + 1] = count;
+            });
+            for (uint32_t c = 0; c < 512; c++) chunkBase[c + 1] += chunkBase[c];
+            result.voxelCount = chunkBase[512];
+            auto indexOf = [&](uint32_t chunk, uint32_t x, uint32_t y, uint32_t z) {
+                return chunkBase[chunk] + rowStart[chunk * 1024 + z * 32 + y] + popcount32(chunkBits(chunk, y, z) & ((1u << x) - 1));
+            };
+
+            // Roots point at the smallest index of their set, so labels don't depend on the thread count
+            std::vector<uint32_t> parent(result.voxelCount);
+            auto find = [&parent](uint32_t i) {
+                while (parent[i] != i) {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+                return i;
+            };
+            auto unite = [&](uint32_t a, uint32_t b) {
+                a = find(a);
+                b = find(b);
+                if (a < b) parent[b] = a;
+                else if (b < a) parent[a] = b;
+            };
+
+            // Chunks only touch their own voxels, parallel is safe
+            oom::misc::parallelFor(512, threads, [&](size_t c) {
+                const uint32_t chunk = static_cast<uint32_t>(c);
+                for (uint32_t i = chunkBase[chunk]; i < chunkBase[chunk + 1]; i++) parent[i] = i;
+                for (uint32_t z = 0; z < 32; z++) {
+                    for (uint32_t y = 0; y < 32; y++) {
+                        const uint32_t bits = chunkBits(chunk, y, z);
+                        const uint32_t below = y ? chunkBits(chunk, y - 1, z) : 0;
+                        const uint32_t behind = z ? chunkBits(chunk, y, z - 1) : 0;
+                        for (uint32_t rest = bits; rest; rest &= rest - 1) {
+                            const uint32_t x = static_cast<uint32_t>(lowestBit32(rest));
+                            const uint32_t self = indexOf(chunk, x, y, z);
+                            if (x && ((bits >> (x - 1)) & 1)) unite(self, self - 1);
+                            if ((below >> x) & 1) unite(self, indexOf(chunk, x, y - 1, z));
+                            if ((behind >> x) & 1) unite(self, indexOf(chunk, x, y, z - 1));
+                        }
+                    }
+                }
+            });
+
+            // Faces between chunks, each chunk joins its -x, -y and -z neighbors
+            for (uint32_t chunk = 0; chunk < 512; chunk++) {
+                if (chunkBase[chunk] == chunkBase[chunk + 1]) continue;
+                uint32_t cx, cy, cz;
+                decodeMorton3DOptimized(chunk, cx, cy, cz);
+                for (int axis = 0; axis < 3; axis++) {
+                    const uint32_t c[3] = {cx, cy, cz};
+                    if (c[axis] == 0) continue;
+                    uint32_t n[3] = {cx, cy, cz};
+                    n[axis]--;
+                    const uint32_t neighbor = encodeMorton3D(n[0], n[1], n[2]);
+                    if (chunkBase[neighbor] == chunkBase[neighbor + 1]) continue;
+                    for (uint32_t a = 0; a < 32; a++) {
+                        for (uint32_t b = 0; b < 32; b++) {
+                            uint32_t p[3], q[3];
+                            p[axis] = 0; q[axis] = 31;
+                            p[(axis + 1) % 3] = q[(axis + 1) % 3] = a;
+                            p[(axis + 2) % 3] = q[(axis + 2) % 3] = b;
+                            if (!((chunkBits(chunk, p[1], p[2]) >> p[0]) & 1)) continue;
+                            if (!((chunkBits(neighbor, q[1], q[2]) >> q[0]) & 1)) continue;
+                            unite(indexOf(chunk, p[0], p[1], p[2]), indexOf(neighbor, q[0], q[1], q[2]));
+                        }
+                    }
+                }
+            }
+
+            // Island ids in order of their root, which is their first voxel
+            std::vector<uint32_t> island(result.voxelCount);
+            std::vector<uint32_t> islandStart(1, 0);
+            for (uint32_t i = 0; i < result.voxelCount; i++) {
+                const uint32_t root = find(i);
+                if (root == i) {
+                    island[i] = static_cast<uint32_t>(islandStart.size() - 1);
+                    islandStart.push_back(0);
+                } else {
+                    island[i] = island[root];
+                }
+                islandStart[island[i] + 1]++;
+            }
+            const size_t islandCount = islandStart.size() - 1;
+            for (size_t i = 0; i < islandCount; i++) islandStart[i + 1] += islandStart[i];
+
+            // Gather the voxels of every island, in model space for now
+            std::vector<IslandVoxel> gathered(result.voxelCount);
+            {
+                std::vector<uint32_t> fill(islandStart.begin(), islandStart.end() - 1);
+                for (uint32_t chunk = 0; chunk < 512; chunk++) {
+                    if (chunkBase[chunk] == chunkBase[chunk + 1]) continue;
+                    uint32_t cx, cy, cz;
+                    decodeMorton3DOptimized(chunk, cx, cy, cz);
+                    uint32_t i = chunkBase[chunk];
+                    for (uint32_t z = 0; z < 32; z++) {
+                        for (uint32_t y = 0; y < 32; y++) {
+                            for (uint32_t rest = chunkBits(chunk, y, z); rest; rest &= rest - 1, i++) {
+                                const uint8_t wx = static_cast<uint8_t>(cx * 32 + lowestBit32(rest));
+                                const uint8_t wy = static_cast<uint8_t>(cy * 32 + y), wz = static_cast<uint8_t>(cz * 32 + z);
+                                const BrickMap::Cell cell = cells.get(wx, wy, wz);
+                                gathered[fill[island[i]]++] = IslandVoxel{wx, wy, wz, cell.material, cell.palette};
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Make each island relative to its corner, sort it and hash it
+            struct Shape {
+                uint64_t hash;
+                uint8_t minx, miny, minz, sizex, sizey, sizez;
+            };
+            std::vector<Shape> shapes(islandCount);
+            oom::misc::parallelFor(islandCount, threads, [&](size_t k) {
+                IslandVoxel* begin = gathered.data() + islandStart[k];
+                IslandVoxel* end = gathered.data() + islandStart[k + 1];
+                uint8_t lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+                for (IslandVoxel* v = begin; v != end; v++) {
+                    lo[0] = std::min(lo[0], v->x); lo[1] = std::min(lo[1], v->y); lo[2] = std::min(lo[2], v->z);
+                    hi[0] = std::max(hi[0], v->x); hi[1] = std::max(hi[1], v->y); hi[2] = std::max(hi[2], v->z);
+                }
+                for (IslandVoxel* v = begin; v != end; v++) {
+                    v->x = static_cast<uint8_t>(v->x - lo[0]); v->y = static_cast<uint8_t>(v->y - lo[1]); v->z = static_cast<uint8_t>(v->z - lo[2]);
+                }
+                std::sort(begin, end, [](const IslandVoxel& a, const IslandVoxel& b) {
+                    return Model::makeVoxelKey(a.z, a.y, a.x) < Model::makeVoxelKey(b.z, b.y, b.x);
+                });
+                uint64_t hash = 1469598103934665603ull;    // FNV-1a over the 5 bytes of every voxel
+                for (IslandVoxel* v = begin; v != end; v++) {
+                    for (uint8_t byte : {v->x, v->y, v->z, v->material, v->color}) hash = (hash ^ byte) * 1099511628211ull;
+                }
+                shapes[k] = Shape{hash, lo[0], lo[1], lo[2], static_cast<uint8_t>(hi[0] - lo[0]),
+                                  static_cast<uint8_t>(hi[1] - lo[1]), static_cast<uint8_t>(hi[2] - lo[2])};
+            });
+
+            // First island with a shape becomes its prototype
+            auto sameVoxels = [&](const IslandPrototype& prototype, size_t k) {
+                const size_t count = islandStart[k + 1] - islandStart[k];
+                if (prototype.voxels.size() != count) return false;
+                const IslandVoxel* voxels = gathered.data() + islandStart[k];
+                for (size_t i = 0; i < count; i++) {
+                    const IslandVoxel& a = prototype.voxels[i];
+                    if (a.x != voxels[i].x || a.y != voxels[i].y || a.z != voxels[i].z || a.material != voxels[i].material || a.color != voxels[i].color) return false;
+                }
+                return true;
+            };
+            std::unordered_map<uint64_t, std::vector<uint32_t>> byHash;
+            result.instances.reserve(islandCount);
+            for (size_t k = 0; k < islandCount; k++) {
+                const Shape& shape = shapes[k];
+                std::vector<uint32_t>& candidates = byHash[shape.hash];
+                uint32_t prototype = UINT32_MAX;
+                for (uint32_t candidate : candidates) {
+                    if (sameVoxels(result.prototypes[candidate], k)) { prototype = candidate; break; }
+                }
+                if (prototype == UINT32_MAX) {
+                    prototype = static_cast<uint32_t>(result.prototypes.size());
+                    candidates.push_back(prototype);
+                    IslandPrototype added;
+                    added.hash = shape.hash;
+                    added.sizex = shape.sizex; added.sizey = shape.sizey; added.sizez = shape.sizez;
+                    added.voxels.assign(gathered.begin() + islandStart[k], gathered.begin() + islandStart[k + 1]);
+                    result.prototypes.push_back(std::move(added));
+                }
+                result.instances.push_back(IslandInstance{prototype, shape.minx, shape.miny, shape.minz});
+            }
+            return result;
+        }
+
+        // Transmissive voxels split into the shell seen from outside and the interior of their volume
+        // A liquid or glass volume renders the same from its shell alone (or as one merged volume), each
+        // interior voxel is one more refractive instance that only costs render time
+        struct TransmissiveVolumes {
+            std::array<size_t, 8> shell{};      // per material, voxels touching the outside of their volume
+            std::array<size_t, 8> interior{};   // per material, voxels enclosed by their own material
+            std::array<size_t, 8> cavities{};   // per material, enclosed cells of other materials or air
+            OccupancyGrid interiorVoxels;       // one bit per interior voxel, skip these when emitting instances
+
+            bool isInterior(uint8_t x, uint8_t y, uint8_t z) const { return interiorVoxels.test(x, y, z); }
+            size_t shellCount() const {
+                size_t total = 0;
+                for (size_t count : shell) total += count;
+                return total;
+            }
+            size_t interiorCount() const {
+                size_t total = 0;
+                for (size_t count : interior) total += count;
+                return total;
+            }
+        };
+
+        /**
+        * Classify every transmissive voxel (Material::transmission > 0) as shell or interior
+        * For each transmissive material a flood fill runs from outside its bounds through every cell that
+        * doesn't hold that material, other materials included, so a water voxel behind a glass wall is still
+        * reached. Voxels of the material next to a reached cell are shell, the rest are interior, and cells
+        * the fill never reached (air bubbles, fish) are cavities inside the merged volume. Materials are
+        * filled in parallel, each only over its bounding box plus one cell. Where buckets overlap the later
+        * one wins, as in Model::spatialIndex.
+        * @param threads 0 for defaultThreadCount()
+        */
+        inline TransmissiveVolumes classifyTransmissiveVolumes(const Model& model, unsigned threads = 0) {
+            threads = threads ? threads : oom::misc::defaultThreadCount();
+            TransmissiveVolumes result;
+            const BrickMap& cells = model.spatialIndex();
+
+            struct Region {
+                int material;
+                int lo[3] = {255, 255, 255};
+                int hi[3] = {0, 0, 0};
+                std::vector<uint8_t> state;     // per bounds cell: 0 open, 1 material, 2 reached from outside
+            };
+            std::vector<Region> regions;
+            int regionOf[8];
+            for (int m = 0; m < 8; m++) {
+                regionOf[m] = -1;
+                if (!(model.materials[m].transmission > 0.0)) continue;
+                bool used = false;
+                for (int c = 1; c < 256 && !used; c++) used = model.getVoxelCount(m, c) != 0;   // storage, stats may be stale after direct edits
+                if (!used) continue;
+                regionOf[m] = static_cast<int>(regions.size());
+                regions.emplace_back();
+                regions.back().material = m;
+            }
+            if (regions.empty()) return result;
+            model.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t) {
+                if (regionOf[material] < 0) return;
+                Region& region = regions[regionOf[material]];
+                const int p[3] = {x, y, z};
+                for (int a = 0; a < 3; a++) {
+                    region.lo[a] = std::min(region.lo[a], p[a]);
+                    region.hi[a] = std::max(region.hi[a], p[a]);
+                }
+            });
+
+            oom::misc::parallelFor(regions.size(), threads, [&](size_t r) {
+                Region& region = regions[r];
+                // One cell of margin, cells past 0/255 are outside the model and count as reached
+                int lo[3], size[3];
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = std::max(region.lo[a] - 1, 0);
+                    size[a] = std::min(region.hi[a] + 1, 255) - lo[a] + 1;
+                }
+                std::vector<uint8_t>& state = region.state;
+                state.assign(size_t(size[0]) * size[1] * size[2], 0);
+                auto index = [&](int x, int y, int z) { return (size_t(z) * size[1] + y) * size[0] + x; };
+                for (int z = 0; z < size[2]; z++) {
+                    for (int y = 0; y < size[1]; y++) {
+                        for (int x = 0; x < size[0]; x++) {
+                            const BrickMap::Cell cell = cells.get(static_cast<uint8_t>(lo[0] + x), static_cast<uint8_t>(lo[1] + y), static_cast<uint8_t>(lo[2] + z));
+                            if (cell.palette && cell.material == region.material) state[index(x, y, z)] = 1;
+                        }
+                    }
+                }
+
+                // Seed from the faces of the box, the margin is never the material unless it's the model edge
+                std::vector<uint32_t> stack;
+                auto reach = [&](int x, int y, int z) {
+                    uint8_t& cell = state[index(x, y, z)];
+                    if (cell != 0) return;
+                    cell = 2;
+                    stack.push_back(static_cast<uint32_t>(index(x, y, z)));
+                };
+                for (int z = 0; z < size[2]; z++) {
+                    for (int y = 0; y < size[1]; y++) {
+                        for (int x = 0; x < size[0]; x++) {
+                            if (x == 0 || y == 0 || z == 0 || x == size[0] - 1 || y == size[1] - 1 || z == size[2] - 1) reach(x, y, z);
+                        }
+                    }
+                }
+                while (!stack.empty()) {
+                    const uint32_t i = stack.back();
+                    stack.pop_back();
+                    const int x = static_cast<int>(i % size[0]), y = static_cast<int>(i / size[0] % size[1]), z = static_cast<int>(i / (size_t(size[0]) * size[1]));
+                    if (x > 0) reach(x - 1, y, z);
+                    if (x + 1 < size[0]) reach(x + 1, y, z);
+                    if (y > 0) reach(x, y - 1, z);
+                    if (y + 1 < size[1]) reach(x, y + 1, z);
+                    if (z > 0) reach(x, y, z - 1);
+                    if (z + 1 < size[2]) reach(x, y, z + 1);
+                }
+                for (int a = 0; a < 3; a++) region.lo[a] = lo[a], region.hi[a] = lo[a] + size[a] - 1;
+            });
+
+            // Shell voxels see a reached cell or the edge of the box, which is outside the model or reached
+            for (Region& region : regions) {
+                const int size[3] = {region.hi[0] - region.lo[0] + 1, region.hi[1] - region.lo[1] + 1, region.hi[2] - region.lo[2] + 1};
+                auto at = [&](int x, int y, int z) -> uint8_t {
+                    if (x < 0 || y < 0 || z < 0 || x >= size[0] || y >= size[1] || z >= size[2]) return 2;
+                    return region.state[(size_t(z) * size[1] + y) * size[0] + x];
+                };
+                for (int z = 0; z < size[2]; z++) {
+                    for (int y = 0; y < size[1]; y++) {
+                        for (int x = 0; x < size[0]; x++) {
+                            const uint8_t cell = at(x, y, z);
+                            if (cell == 0) {
+                                result.cavities[region.material]++;
+                            } else if (cell == 1) {
+                                if (at(x - 1, y, z) == 2 || at(x + 1, y, z) == 2 || at(x, y - 1, z) == 2 ||
+                                    at(x, y + 1, z) == 2 || at(x, y, z - 1) == 2 || at(x, y, z + 1) == 2) {
+                                    result.shell[region.material]++;
+                                } else {
+                                    result.interior[region.material]++;
+                                    result.interiorVoxels.set(static_cast<uint8_t>(region.lo[0] + x), static_cast<uint8_t>(region.lo[1] + y),
+                                                              static_cast<uint8_t>(region.lo[2] + z));
+                                }
+                            }
+                        }
+                    }
+                }
+                std::vector<uint8_t>().swap(region.state);
+            }
+            return result;
+        }
+
+        // Structure to hold object/model information from VoxelMax's scene.json
+        struct JsonModelInfo {
+            std::string id;
+            std::string parentId;
+            std::string name;
+            std::string dataFile;       // The .vmaxb file
+            std::string paletteFile;    // The palette PNG
+            std::string historyFile;    // The history file, not sure what this is
+            
+            // Transform information
+            std::vector<double> position;      // t_p
+            std::vector<double> rotation;      // t_r
+            std::vector<double> scale;         // t_s
+            
+            // Extent information
+            std::vector<double> extentCenter;  // e_c
             std::vector<double> extentMin;     // e_mi
             std::vector<double> extentMax;     // e_ma
         };
@@ -990,5 +3895,205 @@ namespace oom {
                 }
             }
         };
+
+        // Every model instance of a scene in one sparse grid, 32 bit coordinates
+        // A Model stops at 256^3, a scene doesn't. Space is cut in 8x8x8 bricks found through a hash of the
+        // brick coordinate, so only occupied bricks cost memory wherever they are, anywhere in the int32_t
+        // range on every axis. Cells remember which source model (vmaxb and palette) they came from since
+        // material and color indices are local to that model's palette.
+        class World {
+        public:
+            struct Cell {
+                uint8_t palette = 0;    // 0 means empty
+                uint8_t material = 0;
+                uint16_t source = 0;    // index into sources()
+            };
+            using Brick = std::array<Cell, BrickMap::cellsPerBrick>;
+
+            // Where the voxels of a source came from
+            struct Source {
+                std::string dataFile;       // contentsN.vmaxb
+                std::string paletteFile;    // palette png of the model
+            };
+
+            uint16_t addSource(const std::string& dataFile, const std::string& paletteFile) {
+                if (sourceList.size() > 0xffff) throw std::runtime_error("World: too many source models");
+                sourceList.push_back(Source{dataFile, paletteFile});
+                return static_cast<uint16_t>(sourceList.size() - 1);
+            }
+            const std::vector<Source>& sources() const { return sourceList; }
+
+            void set(int32_t x, int32_t y, int32_t z, uint8_t material, uint8_t palette, uint16_t source) {
+                uint32_t index;
+                auto it = brickLookup.find(brickKey(x, y, z));
+                if (it != brickLookup.end()) {
+                    index = it->second;
+                } else if (palette == 0) {
+                    return;     // clearing a cell of a brick that doesn't exist, don't allocate one
+                } else {
+                    index = static_cast<uint32_t>(bricks.size());
+                    brickLookup.emplace(brickKey(x, y, z), index);
+                    bricks.emplace_back();
+                }
+                Cell& cell = bricks[index][cellIndex(x, y, z)];
+                if (cell.palette == 0 && palette != 0) occupied++;
+                else if (cell.palette != 0 && palette == 0) occupied--;
+                cell = Cell{palette, material, source};
+                if (palette) grow(x, y, z);
+            }
+
+            Cell get(int32_t x, int32_t y, int32_t z) const {
+                auto it = brickLookup.find(brickKey(x, y, z));
+                return it == brickLookup.end() ? Cell{} : bricks[it->second][cellIndex(x, y, z)];
+            }
+
+            bool has(int32_t x, int32_t y, int32_t z) const {
+                return get(x, y, z).palette != 0;
+            }
+
+            // Largest offset on an axis that still fits a whole 256^3 model inside the int32_t range
+            static constexpr int32_t maxModelOffset = INT32_MAX - 255;
+
+            /**
+            * Stamp a model into the world at an offset, later voxels overwrite earlier ones
+            * Goes bucket by bucket, so inside one model the winner at a shared position is the same as getVoxelsAt
+            * Throws when an offset is above maxModelOffset, the model space would run past INT32_MAX
+            */
+            void addModel(const Model& model, int32_t offsetX, int32_t offsetY, int32_t offsetZ, uint16_t source) {
+                if (offsetX > maxModelOffset || offsetY > maxModelOffset || offsetZ > maxModelOffset) {
+                    throw std::runtime_error("World: model offset out of the int32_t range");
+                }
+                model.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t color) {
+                    set(offsetX + x, offsetY + y, offsetZ + z, material, color, source);
+                });
+            }
+
+            // visit(x, y, z, cell) for every occupied cell, brick by brick in no particular order
+            template <typename Visit>
+            void forEachVoxel(Visit&& visit) const {
+                for (const auto& [key, index] : brickLookup) {
+                    const int32_t bx = key.x * 8, by = key.y * 8, bz = key.z * 8;
+                    const Brick& brick = bricks[index];
+                    for (uint32_t cell = 0; cell < BrickMap::cellsPerBrick; cell++) {
+                        if (brick[cell].palette) visit(bx + int32_t(cell & 7), by + int32_t((cell >> 3) & 7), bz + int32_t(cell >> 6), brick[cell]);
+                    }
+                }
+            }
+
+            size_t size() const { return occupied; }
+            bool empty() const { return occupied == 0; }
+            size_t brickCount() const { return bricks.size(); }
+            size_t memoryBytes() const {
+                return bricks.capacity() * sizeof(Brick) + brickLookup.size() * (sizeof(BrickKey) + sizeof(uint32_t) + 2 * sizeof(void*)) +
+                       brickLookup.bucket_count() * sizeof(void*);
+            }
+            // Inclusive bounds of everything set so far, only valid when !empty()
+            int32_t minx = 0, miny = 0, minz = 0, maxx = 0, maxy = 0, maxz = 0;
+
+        private:
+            // floor(v / 8) for negative coordinates too
+            static int32_t brickCoord(int32_t v) { return (v - (v & 7)) / 8; }
+            static uint32_t cellIndex(int32_t x, int32_t y, int32_t z) {
+                return ((uint32_t(z) & 7u) * 8 + (uint32_t(y) & 7u)) * 8 + (uint32_t(x) & 7u);
+            }
+            // Brick coordinates kept whole, 29 bits per axis, so every 32 bit voxel coordinate has its own brick
+            struct BrickKey {
+                int32_t x, y, z;
+                bool operator==(const BrickKey& other) const { return x == other.x && y == other.y && z == other.z; }
+            };
+            struct BrickKeyHash {
+                size_t operator()(const BrickKey& key) const {
+                    uint64_t h = uint64_t(uint32_t(key.x)) * 0x9E3779B97F4A7C15ull;
+                    h = (h ^ (h >> 29) ^ uint32_t(key.y)) * 0xBF58476D1CE4E5B9ull;
+                    h = (h ^ (h >> 32) ^ uint32_t(key.z)) * 0x94D049BB133111EBull;
+                    return static_cast<size_t>(h ^ (h >> 31));
+                }
+            };
+            static BrickKey brickKey(int32_t x, int32_t y, int32_t z) {
+                return BrickKey{brickCoord(x), brickCoord(y), brickCoord(z)};
+            }
+            void grow(int32_t x, int32_t y, int32_t z) {
+                if (!boundsSet) {
+                    minx = maxx = x; miny = maxy = y; minz = maxz = z;
+                    boundsSet = true;
+                    return;
+                }
+                minx = std::min(minx, x); miny = std::min(miny, y); minz = std::min(minz, z);
+                maxx = std::max(maxx, x); maxy = std::max(maxy, y); maxz = std::max(maxz, z);
+            }
+
+            std::unordered_map<BrickKey, uint32_t, BrickKeyHash> brickLookup;    // brick coordinate -> index in bricks
+            std::vector<Brick> bricks;
+            std::vector<Source> sourceList;
+            size_t occupied = 0;
+            bool boundsSet = false;
+        };
+
+        // What loadWorld did
+        struct WorldLoadReport {
+            size_t files = 0;               // distinct vmaxb files decoded
+            size_t instances = 0;           // model instances placed
+            size_t skipped = 0;             // instances whose position doesn't fit World coordinates
+            size_t peakModelBytes = 0;      // largest single model arena, the transient part of the load
+        };
+
+        /**
+        * Merge every model instance of a scene into a World
+        * Each distinct vmaxb is decoded once into its own ModelArena, stamped at every instance that uses
+        * it, and released before the next file, so memory stays at the world plus one model.
+        * Every (vmaxb, palette) pair gets its own World::Source, instances sharing a file may recolor it.
+        * Placement is the instance's t_p rounded to whole voxels. Rotation, scale and parent group
+        * transforms are not applied. Instances placed outside INT32_MIN..World::maxModelOffset are skipped.
+        * 
+        * @param world world to merge into
+        * @param scene parsed scene.json
+        * @param sceneDirectory folder holding scene.json and the contentsN.vmaxb files
+        * @param options decode options for every model, packed storage is always used
+        */
+        inline WorldLoadReport loadWorld(World& world, const JsonSceneParser& scene, const std::string& sceneDirectory,
+                                         const ModelLoadOptions& options = {}) {
+            WorldLoadReport report;
+            ModelLoadOptions modelOptions = options;
+            modelOptions.packed = true;
+            for (const auto& [dataFile, instances] : scene.getModelContentVMaxbMap()) {
+                if (instances.empty()) continue;
+                ModelArena arena;
+                {
+                    Model model(dataFile, arena.resource());
+                    const std::string path = (std::filesystem::path(sceneDirectory) / dataFile).string();
+                    loadModel(model, path, true, modelOptions);
+                    // Indices are palette local, instances of one file with different palettes are different sources
+                    std::map<std::string, uint16_t> sourceForPalette;
+                    for (const JsonModelInfo& instance : instances) {
+                        // Range check the placement once, on the rounded value, so the per voxel adds can't overflow
+                        int32_t offset[3] = {0, 0, 0};
+                        bool inRange = true;
+                        for (size_t i = 0; i < 3 && i < instance.position.size(); i++) {
+                            const double p = instance.position[i];
+                            if (!(p > double(INT32_MIN) - 0.5 && p < double(World::maxModelOffset) + 0.5)) {
+                                inRange = false;
+                                break;
+                            }
+                            offset[i] = static_cast<int32_t>(std::lround(p));
+                        }
+                        if (!inRange) {
+                            std::cerr << "Warning: skipping instance of " << dataFile << ", position out of range" << std::endl;
+                            report.skipped++;
+                            continue;
+                        }
+                        auto found = sourceForPalette.find(instance.paletteFile);
+                        if (found == sourceForPalette.end()) {
+                            found = sourceForPalette.emplace(instance.paletteFile, world.addSource(dataFile, instance.paletteFile)).first;
+                        }
+                        const uint16_t source = found->second;
+                        world.addModel(model, offset[0], offset[1], offset[2], source);
+                        report.instances++;
+                    }
+                }
+                report.peakModelBytes = std::max(report.peakModelBytes, arena.reservedBytes());
+                report.files++;
+            }
+            return report;
+        }
     }
 }
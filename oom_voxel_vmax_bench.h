@@ -0,0 +1,755 @@
+#pragma once
+
+// Microbenchmarks for oom_voxel_vmax.h
+// Not part of the conversion path, call them from a scratch main() to compare implementations:
+//
+//     #include "oom_voxel_vmax_bench.h"
+//     int main() { oom::vmax::bench::benchmarkMortonDecode(); }
+
+#include <chrono>       // For timing
+#include <random>       // For reproducible test data
+#include <memory>       // For std::unique_ptr
+#include <cmath>        // For the synthetic terrain
+
+#include "oom_voxel_vmax.h"
+#include "oom_lzfse.h"    // For verifyStreamingLZFSE
+
+#ifdef OOM_VMAX_BENCH_COUNT_ALLOCATIONS
+// Counts heap allocations for the allocation benchmarks
+// Replaces the global operator new, so define the macro in exactly one translation unit
+#include <cstdlib>
+#include <new>
+namespace oom { namespace vmax { namespace bench {
+    inline std::atomic<uint64_t> allocationCount{0};
+}}}
+void* operator new(size_t size) {
+    oom::vmax::bench::allocationCount++;
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmismatched-new-delete" // malloc/free pair, gcc only sees new/free
+#endif
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+#endif
+
+namespace oom {
+    namespace vmax {
+        namespace bench {
+
+            // Allocations made by `body`, 0 when allocation counting isn't compiled in
+            template <typename Body>
+            inline uint64_t countAllocations(Body&& body) {
+            #ifdef OOM_VMAX_BENCH_COUNT_ALLOCATIONS
+                uint64_t before = allocationCount;
+                body();
+                return allocationCount - before;
+            #else
+                body();
+                return 0;
+            #endif
+            }
+
+            // Run `body` `repeats` times and return the best wall time in nanoseconds
+            // Best-of rather than mean so a context switch doesn't skew the comparison
+            template <typename Body>
+            inline double bestOfNs(int repeats, Body&& body) {
+                double best = 1e300;
+                for (int r = 0; r < repeats; r++) {
+                    auto start = std::chrono::steady_clock::now();
+                    body();
+                    auto stop = std::chrono::steady_clock::now();
+                    best = std::min(best, std::chrono::duration<double, std::nano>(stop - start).count());
+                }
+                return best;
+            }
+
+            // Scalar decodeMorton3DOptimized against every batch decoder this CPU supports
+            // @param count: number of random 24 bit codes to decode per run
+            inline void benchmarkMortonDecode(size_t count = size_t(1) << 22, int repeats = 10) {
+                std::mt19937 rng(42);
+                std::vector<uint32_t> codes(count);
+                for (auto& code : codes) code = rng() & 0x00ffffff;
+                std::vector<uint8_t> xs(count), ys(count), zs(count);
+                uint64_t checksum = 0;
+
+                double scalarNs = bestOfNs(repeats, [&] {
+                    for (size_t i = 0; i < count; i++) {
+                        uint32_t x, y, z;
+                        decodeMorton3DOptimized(codes[i], x, y, z);
+                        xs[i] = static_cast<uint8_t>(x);
+                        ys[i] = static_cast<uint8_t>(y);
+                        zs[i] = static_cast<uint8_t>(z);
+                    }
+                });
+                const std::vector<uint8_t> expectX = xs, expectY = ys, expectZ = zs;
+                std::cout << "Morton decode, " << count << " codes" << std::endl;
+                std::cout << "  scalar compactBits: " << scalarNs / count << " ns/code" << std::endl;
+
+                auto run = [&](const char* name, MortonBatchFn fn) {
+                    double ns = bestOfNs(repeats, [&] { fn(codes.data(), count, xs.data(), ys.data(), zs.data()); });
+                    bool same = xs == expectX && ys == expectY && zs == expectZ;
+                    checksum += xs[count / 2] + ys[count / 3] + zs[count / 5];
+                    std::cout << "  " << name << ": " << ns / count << " ns/code, "
+                              << scalarNs / ns << "x" << (same ? "" : "  MISMATCH") << std::endl;
+                };
+                run("batch table", decodeMorton3DBatchTable);
+            #ifdef OOM_VMAX_X86
+                if (cpuHasAVX2()) run("batch avx2", decodeMorton3DBatchAVX2);
+                if (cpuHasBMI2()) run("batch bmi2", decodeMorton3DBatchBMI2);
+            #endif
+                const char* dispatched = nullptr;
+                selectMortonBatchDecoder(&dispatched);
+                std::cout << "  dispatch picks: " << dispatched << " (checksum " << checksum << ")" << std::endl;
+            }
+
+            // decodeVoxels on a 32x32x32 chunk at several fill rates against the old decode-every-slot loop
+            inline void benchmarkDecodeVoxels(int repeats = 20) {
+                std::mt19937 rng(7);
+                std::cout << "decodeVoxels, 32768 slot chunk" << std::endl;
+                for (double fill : {0.0, 0.01, 0.05, 0.25, 1.0}) {
+                    std::vector<uint8_t> ds(32768 * 2, 0);
+                    for (size_t slot = 0; slot < 32768; slot++) {
+                        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng) < fill) {
+                            ds[slot * 2] = static_cast<uint8_t>(rng() & 7);
+                            ds[slot * 2 + 1] = static_cast<uint8_t>(1 + rng() % 255);
+                        }
+                    }
+                    size_t produced = 0;
+                    double legacyNs = bestOfNs(repeats, [&] {
+                        std::vector<Voxel> voxels;
+                        for (size_t i = 0; i + 1 < ds.size(); i += 2) {
+                            uint32_t x, y, z;
+                            decodeMorton3DOptimized(static_cast<uint32_t>(i / 2), x, y, z);
+                            if (ds[i + 1] != 0) {
+                                voxels.emplace_back(x, y, z, ds[i], ds[i + 1], 0, 0);
+                            }
+                        }
+                        produced = voxels.size();
+                    });
+                    size_t skipped = 0;
+                    double skipNs = bestOfNs(repeats, [&] { skipped = decodeVoxels(ds, 0, 0).size(); });
+                    std::cout << "  fill " << fill * 100 << "%: legacy " << legacyNs / 1000 << " us, skipping "
+                              << skipNs / 1000 << " us, " << legacyNs / skipNs << "x"
+                              << (produced == skipped ? "" : "  MISMATCH") << std::endl;
+                }
+            }
+
+            // Synthetic vmaxb snapshots: `chunks` full 32x32x32 chunks at the given fill rate
+            inline std::vector<std::vector<uint8_t>> makeSnapshotStreams(size_t chunks, double fill, uint32_t seed = 11) {
+                std::mt19937 rng(seed);
+                std::vector<std::vector<uint8_t>> streams(chunks, std::vector<uint8_t>(32768 * 2, 0));
+                for (auto& ds : streams) {
+                    for (size_t slot = 0; slot < 32768; slot++) {
+                        if (std::uniform_real_distribution<double>(0.0, 1.0)(rng) < fill) {
+                            ds[slot * 2] = static_cast<uint8_t>(rng() & 7);
+                            ds[slot * 2 + 1] = static_cast<uint8_t>(1 + rng() % 255);
+                        }
+                    }
+                }
+                return streams;
+            }
+
+            // Two step vmaxVoxelInfo + addVoxel against the fused Model::addSnapshot
+            // Build with OOM_VMAX_BENCH_COUNT_ALLOCATIONS to see allocations per chunk. Model storage
+            // (bucket growth) is measured on its own and subtracted so what's left
+            // is the per chunk overhead of the decode path itself.
+            inline void benchmarkSnapshotDecode(size_t chunks = 64, double fill = 0.1) {
+                auto streams = makeSnapshotStreams(chunks, fill);
+                std::cout << "Snapshot decode, " << chunks << " chunks at " << fill * 100 << "% fill" << std::endl;
+
+                // Storage only: insert already decoded voxels
+                std::vector<std::vector<Voxel>> decoded;
+                for (size_t c = 0; c < chunks; c++) {
+                    decoded.push_back(vmaxVoxelInfo(ByteSpan(streams[c].data(), streams[c].size()), c, 0));
+                }
+                Model storageModel("storage");
+                uint64_t storageAllocs = countAllocations([&] {
+                    for (const auto& chunkVoxels : decoded) {
+                        for (const Voxel& v : chunkVoxels) {
+                            storageModel.addVoxel(v.x, v.y, v.z, v.material, v.palette, v.chunkID, v.minMorton);
+                        }
+                    }
+                });
+
+                Model legacyModel("legacy");
+                uint64_t legacyAllocs = 0;
+                double legacyNs = bestOfNs(1, [&] {
+                    legacyAllocs = countAllocations([&] {
+                        for (size_t c = 0; c < chunks; c++) {
+                            // plist_get_data_val hands back a copy of ds
+                            std::vector<uint8_t> copy(streams[c]);
+                            std::vector<Voxel> chunkVoxels = vmaxVoxelInfo(ByteSpan(copy.data(), copy.size()), c, 0);
+                            for (const Voxel& v : chunkVoxels) {
+                                legacyModel.addVoxel(v.x, v.y, v.z, v.material, v.palette, v.chunkID, v.minMorton);
+                            }
+                        }
+                    });
+                });
+
+                Model fusedModel("fused");
+                uint64_t fusedAllocs = 0;
+                double fusedNs = bestOfNs(1, [&] {
+                    fusedAllocs = countAllocations([&] {
+                        for (size_t c = 0; c < chunks; c++) {
+                            fusedModel.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                        }
+                    });
+                });
+
+                bool same = legacyModel.getTotalVoxelCount() == fusedModel.getTotalVoxelCount();
+                std::cout << "  two step: " << legacyNs / 1e6 << " ms, fused: " << fusedNs / 1e6 << " ms, "
+                          << legacyNs / fusedNs << "x" << (same ? "" : "  MISMATCH") << std::endl;
+            #ifdef OOM_VMAX_BENCH_COUNT_ALLOCATIONS
+                std::cout << "  decode allocations per chunk (excluding model storage): two step "
+                          << double(legacyAllocs - storageAllocs) / chunks << ", fused "
+                          << double(fusedAllocs - storageAllocs) / chunks << std::endl;
+            #else
+                (void)storageAllocs;
+                std::cout << "  build with OOM_VMAX_BENCH_COUNT_ALLOCATIONS for allocation counts" << std::endl;
+            #endif
+            }
+
+            // Serial vs parallel loadSnapshots on a synthetic snapshot set, checks both models match
+            inline void benchmarkParallelLoad(size_t chunks = 512, double fill = 0.1, unsigned threads = 0) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 8);
+                std::vector<SnapshotView> snapshots;
+                snapshots.reserve(chunks);
+                for (size_t c = 0; c < chunks; c++) {
+                    snapshots.push_back(SnapshotView{static_cast<int64_t>(c & 511), 0, 0, ByteSpan(streams[c].data(), streams[c].size())});
+                }
+                ModelLoadOptions parallel;
+                parallel.threads = threads;
+
+                std::cout << "loadSnapshots, " << chunks << " snapshots at " << fill * 100 << "% fill" << std::endl;
+                size_t serialCount = 0, parallelCount = 0;
+                unsigned used = 1;
+                double serialNs = bestOfNs(3, [&] {
+                    Model model("serial");
+                    loadSnapshots(model, snapshots);
+                    serialCount = model.getTotalVoxelCount();
+                });
+                double parallelNs = bestOfNs(3, [&] {
+                    Model model("parallel");
+                    used = loadSnapshots(model, snapshots, parallel).threads;
+                    parallelCount = model.getTotalVoxelCount();
+                });
+                std::cout << "  serial: " << serialNs / 1e6 << " ms, " << used << " threads: " << parallelNs / 1e6 << " ms, "
+                          << serialNs / parallelNs << "x" << (serialCount == parallelCount ? "" : "  MISMATCH") << std::endl;
+            }
+
+            // getVoxelsAt and index build time, brick map vs the std::map<uint32_t, std::vector<Voxel>> it replaced
+            inline void benchmarkSpatialLookup(size_t chunks = 64, double fill = 0.1, size_t lookups = 1 << 22) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 12);
+                Model model("lookup");
+                std::map<uint32_t, std::vector<Voxel>> legacy;
+                for (size_t c = 0; c < chunks; c++) {
+                    model.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                double mapBuildNs = bestOfNs(1, [&] {
+                    for (int m = 0; m < 8; m++) {
+                        for (int c = 1; c < 256; c++) {
+                            for (const Voxel& v : model.voxels[m][c]) legacy[Model::makeVoxelKey(v.x, v.y, v.z)].push_back(v);
+                        }
+                    }
+                });
+                double brickBuildNs = bestOfNs(3, [&] {
+                    model.invalidateSpatialIndex();
+                    model.spatialIndex();
+                });
+                std::mt19937 rng(5);
+                std::vector<uint32_t> keys(lookups);
+                for (uint32_t& key : keys) key = rng() & 0xffffff;
+
+                size_t brickHits = 0, mapHits = 0;
+                double brickNs = bestOfNs(3, [&] {
+                    brickHits = 0;
+                    for (uint32_t key : keys) brickHits += model.getVoxelsAt(key >> 16, (key >> 8) & 255, key & 255).size();
+                });
+                double mapNs = bestOfNs(3, [&] {
+                    mapHits = 0;
+                    for (uint32_t key : keys) {
+                        auto it = legacy.find(key);
+                        mapHits += it != legacy.end() ? 1 : 0;
+                    }
+                });
+                size_t mapBytes = legacy.size() * (sizeof(std::pair<const uint32_t, std::vector<Voxel>>) + 32 + sizeof(Voxel));
+                std::cout << "getVoxelsAt, " << legacy.size() << " occupied positions" << std::endl;
+                std::cout << "  std::map: " << mapNs / lookups << " ns/lookup, ~" << mapBytes / 1024 << " KiB, "
+                          << mapBuildNs / 1e6 << " ms to build" << std::endl;
+                std::cout << "  bricks:   " << brickNs / lookups << " ns/lookup, " << brickBuildNs / 1e6 << " ms to build, " << model.spatialIndex().memoryBytes() / 1024 << " KiB in "
+                          << model.spatialIndex().brickCount() << " bricks" << (brickHits == mapHits ? "" : "  MISMATCH") << std::endl;
+            }
+
+            // Memory and iteration speed of voxels[8][256] vs the packed arena
+            inline void benchmarkPackedVoxels(size_t chunks = 128, double fill = 0.2) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 13);
+                Model model("packed");
+                for (size_t c = 0; c < chunks; c++) {
+                    model.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                size_t vectorBytes = 0;
+                for (int m = 0; m < 8; m++) {
+                    for (int c = 0; c < 256; c++) vectorBytes += model.voxels[m][c].capacity() * sizeof(Voxel);
+                }
+                uint64_t vectorSum = 0, packedSum = 0;
+                double vectorNs = bestOfNs(5, [&] {
+                    vectorSum = 0;
+                    for (int m = 0; m < 8; m++) {
+                        for (int c = 1; c < 256; c++) {
+                            for (const Voxel& v : model.getVoxels(m, c)) vectorSum += v.x + v.y + v.z;
+                        }
+                    }
+                });
+                model.pack();
+                size_t packedBytes = model.packedVoxels.capacity() * sizeof(PackedVoxel) + model.packedOffsets.capacity() * sizeof(uint32_t);
+                double packedNs = bestOfNs(5, [&] {
+                    packedSum = 0;
+                    for (int m = 0; m < 8; m++) {
+                        for (int c = 1; c < 256; c++) {
+                            for (PackedVoxel v : model.getPackedVoxels(m, c)) packedSum += packedX(v) + packedY(v) + packedZ(v);
+                        }
+                    }
+                });
+                std::cout << "Voxel buckets vs packed arena, " << model.getTotalVoxelCount() << " voxels" << std::endl;
+                std::cout << "  vectors: " << vectorBytes / 1024 << " KiB, " << vectorNs / 1e6 << " ms per pass" << std::endl;
+                std::cout << "  packed:  " << packedBytes / 1024 << " KiB, " << packedNs / 1e6 << " ms per pass, "
+                          << double(vectorBytes) / packedBytes << "x smaller" << (vectorSum == packedSum ? "" : "  MISMATCH") << std::endl;
+            }
+
+            // Exposed face count through OccupancyGrid word ops vs one hasVoxelsAt per neighbor
+            // Runs on a fully dense 256^3 model (only the border is exposed) and on a sparse synthetic one
+            inline void benchmarkOccupancy(double sparseFill = 0.1) {
+                auto report = [](const char* name, const Model& model) {
+                    double buildNs = bestOfNs(1, [&] { model.occupancy(); });
+                    const OccupancyGrid& grid = model.occupancy();
+                    size_t wordFaces = 0;
+                    double wordNs = bestOfNs(3, [&] { wordFaces = grid.exposedFaceCount(); });
+                    model.spatialIndex();
+                    size_t lookupFaces = 0;
+                    double lookupNs = bestOfNs(1, [&] {
+                        lookupFaces = 0;
+                        model.forEachVoxel([&](uint8_t x, uint8_t y, uint8_t z, uint8_t, uint8_t) {
+                            lookupFaces += (x == 255 || !model.hasVoxelsAt(x + 1, y, z)) + (x == 0 || !model.hasVoxelsAt(x - 1, y, z)) +
+                                           (y == 255 || !model.hasVoxelsAt(x, y + 1, z)) + (y == 0 || !model.hasVoxelsAt(x, y - 1, z)) +
+                                           (z == 255 || !model.hasVoxelsAt(x, y, z + 1)) + (z == 0 || !model.hasVoxelsAt(x, y, z - 1));
+                        });
+                    });
+                    std::cout << "  " << name << ": " << model.getTotalVoxelCount() << " voxels, " << wordFaces << " exposed faces, grid built in "
+                              << buildNs / 1e6 << " ms" << std::endl;
+                    std::cout << "    bitset: " << wordNs / 1e6 << " ms, hasVoxelsAt: " << lookupNs / 1e6 << " ms, "
+                              << lookupNs / wordNs << "x" << (wordFaces == lookupFaces ? "" : "  MISMATCH") << std::endl;
+                };
+                std::cout << "Face exposure" << std::endl;
+
+                // Dense, straight into the packed arena to keep the test model at 64 MiB
+                Model dense("dense");
+                dense.packedOffsets.assign(8 * 256 + 1, 0);
+                dense.packedVoxels.reserve(size_t(256) * 256 * 256);
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t y = 0; y < 256; y++) {
+                        for (uint32_t x = 0; x < 256; x++) dense.packedVoxels.push_back(packVoxel(x, y, z));
+                    }
+                }
+                for (uint32_t b = 2; b <= 8 * 256; b++) dense.packedOffsets[b] = static_cast<uint32_t>(dense.packedVoxels.size()); // all in material 0, color 1
+                dense.recomputeStats();
+                report("dense", dense);
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(512, sparseFill, 14);
+                Model sparse("sparse");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    sparse.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                report("sparse", sparse);
+            }
+
+            // Build and tear down a model on the heap vs in a ModelArena
+            inline void benchmarkModelArena(size_t chunks = 256, double fill = 0.1) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 15);
+                auto build = [&](Model& model) {
+                    for (size_t c = 0; c < chunks; c++) {
+                        model.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                    }
+                };
+                std::cout << "Model storage, " << chunks << " chunks at " << fill * 100 << "% fill" << std::endl;
+
+                double heapBuildNs = 0, heapFreeNs = 0;
+                {
+                    auto model = std::make_unique<Model>("heap");
+                    heapBuildNs = bestOfNs(1, [&] { build(*model); });
+                    heapFreeNs = bestOfNs(1, [&] { model.reset(); });
+                }
+                double arenaBuildNs = 0, arenaFreeNs = 0;
+                {
+                    auto arena = std::make_unique<ModelArena>();
+                    auto model = std::make_unique<Model>("arena", arena->resource());
+                    arenaBuildNs = bestOfNs(1, [&] { build(*model); });
+                    arena->print();
+                    arenaFreeNs = bestOfNs(1, [&] {
+                        model.reset();
+                        arena.reset();
+                    });
+                }
+                std::cout << "  heap:  build " << heapBuildNs / 1e6 << " ms, free " << heapFreeNs / 1e6 << " ms" << std::endl;
+                std::cout << "  arena: build " << arenaBuildNs / 1e6 << " ms, free " << arenaFreeNs / 1e6 << " ms" << std::endl;
+            }
+
+            // Morton traversal and bucket sorting cost, plus how coherent instancer order gets
+            // Coherence is the mean Manhattan step between consecutive voxels of a bucket, lower is better for BVH builds
+            inline void benchmarkMortonOrder(size_t chunks = 256, double fill = 0.1) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 16);
+                for (std::vector<uint8_t>& stream : streams) {
+                    // few colors so buckets are big, like real models
+                    for (size_t i = 1; i < stream.size(); i += 2) {
+                        if (stream[i]) stream[i] = static_cast<uint8_t>(1 + stream[i] % 4);
+                    }
+                }
+                std::vector<SnapshotView> snapshots;
+                for (size_t c = 0; c < chunks; c++) {
+                    // reversed chunk order, like an edit history that doesn't follow Z order
+                    snapshots.push_back(SnapshotView{static_cast<int64_t>((chunks - 1 - c) & 511), 0, 0, ByteSpan(streams[c].data(), streams[c].size())});
+                }
+                Model model("morton");
+                loadSnapshots(model, snapshots);
+
+                auto meanStep = [&] {
+                    uint64_t steps = 0, pairs = 0;
+                    for (int m = 0; m < 8; m++) {
+                        for (int c = 1; c < 256; c++) {
+                            BucketVoxels bucket = model.getVoxels(m, c);
+                            for (size_t i = 1; i < bucket.size(); i++) {
+                                steps += std::abs(bucket[i].x - bucket[i - 1].x) + std::abs(bucket[i].y - bucket[i - 1].y) + std::abs(bucket[i].z - bucket[i - 1].z);
+                                pairs++;
+                            }
+                        }
+                    }
+                    return pairs ? double(steps) / pairs : 0.0;
+                };
+                double loaded = meanStep();
+                // Snapshots decode in Morton order inside each chunk already, shuffle to stand in for
+                // voxels added in arbitrary order (scene edits, merged models)
+                std::mt19937 rng(16);
+                for (int m = 0; m < 8; m++) {
+                    for (int c = 1; c < 256; c++) std::shuffle(model.voxels[m][c].begin(), model.voxels[m][c].end(), rng);
+                }
+                // Bucket order decides which duplicate wins in the spatial index, drop anything built from the old order
+                model.invalidateSpatialIndex();
+                double before = meanStep();
+                size_t visited = 0;
+                double traverseNs = bestOfNs(3, [&] {
+                    visited = 0;
+                    model.forEachVoxelMortonOrder([&](uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) { visited++; });
+                });
+                double sortNs = bestOfNs(1, [&] { model.sortByMorton(); });
+                double after = meanStep();
+                std::cout << "Morton order, " << model.getTotalVoxelCount() << " voxels" << std::endl;
+                std::cout << "  global traversal: " << traverseNs / 1e6 << " ms, sortByMorton: " << sortNs / 1e6 << " ms"
+                          << (visited == model.getTotalVoxelCount() ? "" : "  MISMATCH") << std::endl;
+                std::cout << "  mean step inside a bucket: " << loaded << " as loaded, " << before << " shuffled, "
+                          << after << " in Morton order" << std::endl;
+            }
+
+            // Memory and random lookup latency: Voxel buckets, packed arena, BrickMap, PaletteBrickGrid
+            // Runs on noisy synthetic snapshots (worst case for palettes) and on a solid terrain with a few colors
+            inline void benchmarkPaletteBricks(size_t lookups = 1 << 22) {
+                auto report = [&](const char* name, Model& model) {
+                    size_t vectorBytes = 0;
+                    for (int m = 0; m < 8; m++) {
+                        for (int c = 0; c < 256; c++) vectorBytes += model.voxels[m][c].capacity() * sizeof(Voxel);
+                    }
+                    const BrickMap& bricks = model.spatialIndex();
+                    PaletteBrickGrid palette(model);
+                    std::mt19937 rng(17);
+                    std::vector<uint32_t> keys(lookups);
+                    for (uint32_t& key : keys) key = rng() & 0xffffff;
+                    size_t brickHits = 0, paletteHits = 0;
+                    double brickNs = bestOfNs(3, [&] {
+                        brickHits = 0;
+                        for (uint32_t key : keys) brickHits += bricks.get(key & 255, (key >> 8) & 255, key >> 16).palette;
+                    });
+                    double paletteNs = bestOfNs(3, [&] {
+                        paletteHits = 0;
+                        for (uint32_t key : keys) paletteHits += palette.get(key & 255, (key >> 8) & 255, key >> 16).palette;
+                    });
+                    size_t total = model.getTotalVoxelCount();
+                    std::cout << "  " << name << ": " << total << " voxels, " << palette.brickCount() << " bricks, "
+                              << palette.uniformBrickCount() << " uniform" << std::endl;
+                    std::cout << "    Voxel buckets " << vectorBytes / 1024 << " KiB, packed ~" << (total * sizeof(PackedVoxel)) / 1024
+                              << " KiB, BrickMap " << bricks.memoryBytes() / 1024 << " KiB, palette bricks " << palette.memoryBytes() / 1024 << " KiB" << std::endl;
+                    std::cout << "    lookup BrickMap " << brickNs / lookups << " ns, palette bricks " << paletteNs / lookups << " ns"
+                              << (brickHits == paletteHits ? "" : "  MISMATCH") << std::endl;
+                };
+                std::cout << "Palette bricks" << std::endl;
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(256, 0.1, 17);
+                Model noisy("noisy");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    noisy.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                report("noisy", noisy);
+
+                Model terrain("terrain");
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t x = 0; x < 256; x++) {
+                        const uint32_t height = 64 + static_cast<uint32_t>(32 * std::sin(x * 0.05) * std::cos(z * 0.04));
+                        for (uint32_t y = 0; y < height; y++) {
+                            const uint8_t color = y + 4 >= height ? 3 : (y + 20 >= height ? 2 : 1); // grass, dirt, stone
+                            terrain.insertVoxel(x, y, z, 0, color, 0, 0);
+                        }
+                    }
+                }
+                report("terrain", terrain);
+            }
+
+            // Octree build time, size and isRegionEmpty latency per level
+            inline void benchmarkOctree(size_t chunks = 256, double fill = 0.1, size_t queries = 1 << 20) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 18);
+                Model model("octree");
+                for (size_t c = 0; c < chunks; c++) {
+                    model.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                SparseVoxelOctree tree;
+                double buildNs = bestOfNs(3, [&] { tree = SparseVoxelOctree(model); });
+                std::cout << "Sparse voxel octree, " << model.getTotalVoxelCount() << " voxels, " << tree.nodes().size() << " nodes, "
+                          << tree.serialize().size() / 1024 << " KiB, built in " << buildNs / 1e6 << " ms" << std::endl;
+                std::mt19937 rng(18);
+                for (uint32_t level : {3u, 5u, 8u}) {
+                    std::vector<uint32_t> keys(queries);
+                    for (uint32_t& key : keys) key = rng();
+                    const uint32_t mask = (1u << level) - 1;
+                    size_t empty = 0;
+                    double ns = bestOfNs(3, [&] {
+                        empty = 0;
+                        for (uint32_t key : keys) empty += tree.isRegionEmpty(level, key & mask, (key >> 8) & mask, (key >> 16) & mask);
+                    });
+                    std::cout << "  isRegionEmpty level " << level << ": " << ns / queries << " ns, " << 100.0 * empty / queries << "% empty" << std::endl;
+                }
+            }
+
+            // Stats queries vs scanning the buckets they replace, and the cost of keeping them during load
+            inline void benchmarkModelStats(size_t chunks = 256, double fill = 0.1, int repeats = 1000) {
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 20);
+                std::vector<SnapshotView> snapshots(chunks);
+                for (size_t c = 0; c < chunks; c++) {
+                    snapshots[c].ds = ByteSpan(streams[c].data(), streams[c].size());
+                    snapshots[c].id = static_cast<int64_t>(c);
+                }
+                Model model("stats");
+                double loadNs = bestOfNs(3, [&] { model = Model("stats"); loadSnapshots(model, snapshots); });
+                size_t scanned = 0, kept = 0;
+                double scanNs = bestOfNs(3, [&] {
+                    for (int r = 0; r < repeats; r++) {
+                        scanned = 0;
+                        for (int m = 0; m < 8; m++) {
+                            for (int c = 1; c < 256; c++) scanned += model.getVoxels(m, c).size();
+                        }
+                    }
+                });
+                double statsNs = bestOfNs(3, [&] {
+                    for (int r = 0; r < repeats; r++) kept = static_cast<size_t>(model.stats().total);
+                });
+                std::string exported = model.statsJson().dump();
+                std::cout << "Model stats, " << kept << " voxels, load " << loadNs / 1e6 << " ms" << std::endl;
+                std::cout << "  total by bucket scan " << scanNs / repeats << " ns, from stats " << statsNs / repeats << " ns"
+                          << (scanned == kept ? "" : "  MISMATCH") << std::endl;
+                std::cout << "  JSON export " << exported.size() << " bytes" << std::endl;
+            }
+
+            // Hidden voxel culling on a solid terrain with a glass layer and on noisy snapshots
+            inline void benchmarkCulling(unsigned threads = 0) {
+                auto report = [&](const char* name, const Model& source) {
+                    Model model = source;
+                    CullReport culled;
+                    double ns = bestOfNs(3, [&] { model = source; culled = cullHiddenVoxels(model, threads); });
+                    std::cout << "  " << name << ": " << culled.before << " -> " << culled.after << " instances ("
+                              << 100.0 * (culled.before - culled.after) / std::max<size_t>(culled.before, 1) << "% culled), "
+                              << ns / 1e6 << " ms on " << culled.threads << " threads" << std::endl;
+                };
+                std::cout << "Hidden voxel culling" << std::endl;
+
+                Model terrain("terrain");
+                terrain.materials[1].transmission = 0.9;
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t x = 0; x < 256; x++) {
+                        const uint32_t height = 64 + static_cast<uint32_t>(32 * std::sin(x * 0.05) * std::cos(z * 0.04));
+                        for (uint32_t y = 0; y < height; y++) {
+                            const uint8_t material = (y >= 40 && y < 42) ? 1 : 0; // a buried sheet of glass
+                            terrain.insertVoxel(x, y, z, material, 1 + y % 3, 0, 0);
+                        }
+                    }
+                }
+                report("terrain", terrain);
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(256, 0.9, 21);
+                Model dense("dense");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    dense.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                report("90% fill", dense);
+            }
+
+            // Greedy meshing, quads vs box instances for a flat build and for noise
+            inline void benchmarkGreedyMesh(unsigned threads = 0) {
+                auto report = [&](const char* name, const Model& model) {
+                    VoxelMesh mesh;
+                    double ns = bestOfNs(3, [&] { mesh = VoxelMesh(model, threads); });
+                    std::cout << "  " << name << ": " << model.getTotalVoxelCount() << " voxels -> " << mesh.quadCount() << " quads in "
+                              << mesh.parts().size() << " parts, " << mesh.memoryBytes() / 1024 << " KiB, " << ns / 1e6 << " ms" << std::endl;
+                };
+                std::cout << "Greedy mesh" << std::endl;
+
+                // A floor with walls and a few colored stripes, the usual architectural build
+                Model flat("flat");
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t x = 0; x < 256; x++) {
+                        for (uint32_t y = 0; y < 4; y++) flat.insertVoxel(x, y, z, 0, 1 + (x / 64 + z / 64) % 3, 0, 0);
+                        if (x % 64 < 2 || z % 64 < 2) {
+                            for (uint32_t y = 4; y < 40; y++) flat.insertVoxel(x, y, z, 0, 5, 0, 0);
+                        }
+                    }
+                }
+                report("flat build", flat);
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(64, 0.1, 22);
+                Model noisy("noisy");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    noisy.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                report("10% noise", noisy);
+            }
+
+            // LOD pyramid build time and instance counts per level
+            inline void benchmarkLod(size_t chunks = 256, double fill = 0.3) {
+                auto report = [&](const char* name, const Model& model) {
+                    const BrickMap& cells = model.spatialIndex();
+                    double ns = bestOfNs(3, [&] { ModelLod levels(cells, model.materials); });
+                    const ModelLod& lod = model.lod();
+                    std::cout << "  " << name << ": " << model.getTotalVoxelCount() << " voxels, pyramid in " << ns / 1e6 << " ms, "
+                              << lod.memoryBytes() / 1024 << " KiB" << std::endl;
+                    for (int l = 1; l <= ModelLod::levelCount; l++) {
+                        std::cout << "    " << ModelLod::resolution(l) << "^3: " << lod.size(l) << " voxels, "
+                                  << double(model.getTotalVoxelCount()) / std::max<size_t>(lod.size(l), 1) << "x fewer" << std::endl;
+                    }
+                };
+                std::cout << "LOD pyramid" << std::endl;
+
+                Model terrain("terrain");
+                for (uint32_t z = 0; z < 256; z++) {
+                    for (uint32_t x = 0; x < 256; x++) {
+                        const uint32_t height = 64 + static_cast<uint32_t>(32 * std::sin(x * 0.05) * std::cos(z * 0.04));
+                        for (uint32_t y = 0; y < height; y++) terrain.insertVoxel(x, y, z, 0, y + 4 >= height ? 3 : 1, 0, 0);
+                    }
+                }
+                report("terrain", terrain);
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(chunks, fill, 23);
+                Model noisy("noisy");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    noisy.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                report("noisy", noisy);
+            }
+
+            // Island instancing on a model made of repeated props
+            inline void benchmarkIslands(unsigned threads = 0) {
+                std::cout << "Island instancing" << std::endl;
+                // A 5x3x4 crate and a 1x6x1 lamp post with a light on top, on a grid with gaps between them
+                Model props("props");
+                for (uint32_t z = 0; z + 8 <= 256; z += 8) {
+                    for (uint32_t x = 0; x + 8 <= 256; x += 8) {
+                        if ((x / 8 + z / 8) % 2) {
+                            for (uint32_t dz = 0; dz < 4; dz++)
+                                for (uint32_t dy = 0; dy < 3; dy++)
+                                    for (uint32_t dx = 0; dx < 5; dx++) props.insertVoxel(x + dx, dy, z + dz, 0, 1 + (dx + dy + dz) % 2, 0, 0);
+                        } else {
+                            for (uint32_t dy = 0; dy < 6; dy++) props.insertVoxel(x, dy, z, 0, 4, 0, 0);
+                            props.insertVoxel(x, 6, z, 1, 7, 0, 0);
+                        }
+                    }
+                }
+                ModelIslands islands;
+                double ns = bestOfNs(3, [&] { islands = findIslands(props, threads); });
+                std::cout << "  props: " << islands.voxelCount << " voxels, " << islands.instances.size() << " islands -> "
+                          << islands.prototypes.size() << " prototypes, " << islands.prototypeVoxelCount() << " voxels emitted, "
+                          << ns / 1e6 << " ms" << std::endl;
+
+                std::vector<std::vector<uint8_t>> streams = makeSnapshotStreams(256, 0.1, 24);
+                Model noisy("noisy");
+                for (size_t c = 0; c < streams.size(); c++) {
+                    noisy.addSnapshot(ByteSpan(streams[c].data(), streams[c].size()), c, 0);
+                }
+                ns = bestOfNs(3, [&] { islands = findIslands(noisy, threads); });
+                std::cout << "  10% noise: " << islands.voxelCount << " voxels, " << islands.instances.size() << " islands -> "
+                          << islands.prototypes.size() << " prototypes, " << ns / 1e6 << " ms" << std::endl;
+            }
+
+            // Transmissive shell vs interior on a fish tank: glass walls, water 3/4 up, sand and fish inside
+            // Only the instance counts are measured here, render time needs Bella
+            inline void benchmarkTransmissiveVolumes(unsigned threads = 0) {
+                Model tank("tank");
+                tank.materials[1].transmission = 1.0;   // glass
+                tank.materials[2].transmission = 0.9;   // water
+                const uint32_t x0 = 40, x1 = 200, z0 = 60, z1 = 160, y1 = 100;
+                OccupancyGrid fish;
+                std::mt19937 rng(25);
+                for (int f = 0; f < 40; f++) {
+                    const uint32_t fx = x0 + 10 + rng() % 140, fy = 15 + rng() % 50, fz = z0 + 10 + rng() % 80;
+                    for (uint32_t dz = 0; dz < 2; dz++)
+                        for (uint32_t dy = 0; dy < 3; dy++)
+                            for (uint32_t dx = 0; dx < 6; dx++) fish.set(fx + dx, fy + dy, fz + dz);
+                }
+                for (uint32_t z = z0; z <= z1; z++) {
+                    for (uint32_t y = 0; y <= y1; y++) {
+                        for (uint32_t x = x0; x <= x1; x++) {
+                            const bool wall = x == x0 || x == x1 || z == z0 || z == z1 || y == 0;
+                            if (wall) tank.insertVoxel(x, y, z, 1, 10, 0, 0);
+                            else if (y <= 8) tank.insertVoxel(x, y, z, 0, 20, 0, 0);         // sand
+                            else if (fish.test(x, y, z)) tank.insertVoxel(x, y, z, 0, 40, 0, 0);
+                            else if (y <= 75) tank.insertVoxel(x, y, z, 2, 30, 0, 0);        // water
+                        }
+                    }
+                }
+                TransmissiveVolumes volumes;
+                double ns = bestOfNs(3, [&] { volumes = classifyTransmissiveVolumes(tank, threads); });
+                const size_t transmissive = volumes.shellCount() + volumes.interiorCount();
+                std::cout << "Transmissive volumes, fish tank " << tank.getTotalVoxelCount() << " voxels, " << ns / 1e6 << " ms" << std::endl;
+                std::cout << "  glass: " << volumes.shell[1] << " shell, " << volumes.interior[1] << " interior" << std::endl;
+                std::cout << "  water: " << volumes.shell[2] << " shell, " << volumes.interior[2] << " interior, "
+                          << volumes.cavities[2] << " enclosed cells" << std::endl;
+                std::cout << "  refractive instances " << transmissive << " -> " << volumes.shellCount() << ", "
+                          << double(transmissive) / std::max<size_t>(volumes.shellCount(), 1) << "x fewer" << std::endl;
+            }
+
+            // Check decompressLZFSE against lzfse_decode_buffer on a real file, byte for byte
+            // Use a window smaller than the file so blocks are decoded across several slices
+            inline bool verifyStreamingLZFSE(const std::string& dirName, const std::string& compressedName, size_t windowSize = 64 * 1024) {
+                oom::misc::MappedFile file;
+                if (!file.open(dirName + "/" + compressedName)) return false;
+                size_t decodedSize = 0;
+                if (!lzfseDecodedSize(file.data(), file.size(), decodedSize)) return false;
+                std::vector<uint8_t> whole(decodedSize + 1);
+                std::vector<uint8_t> scratch(lzfse_decode_scratch_size());
+                whole.resize(lzfse_decode_buffer(whole.data(), whole.size(), file.data(), file.size(), scratch.data()));
+
+                size_t offset = 0;
+                bool same = whole.size() == decodedSize;
+                double ns = bestOfNs(1, [&] {
+                    oom::misc::decompressLZFSE(dirName, compressedName, [&](const uint8_t* data, size_t size) {
+                        same = same && offset + size <= whole.size() && std::memcmp(whole.data() + offset, data, size) == 0;
+                        offset += size;
+                        return true;
+                    }, windowSize);
+                });
+                same = same && offset == whole.size();
+                std::cout << "Streaming LZFSE " << compressedName << ": " << offset << " bytes in " << ns / 1e6 << " ms, "
+                          << (same ? "identical to lzfse_decode_buffer" : "MISMATCH") << std::endl;
+                return same;
+            }
+        }
+    }
+}